@@ -1,5 +1,7 @@
 #include "definitions.h"
 
+#include <algorithm>
+
 namespace AB {
     const char* block_to_name(BLOCK_TYPE type) {
         switch (type) {
@@ -148,4 +150,106 @@ namespace AB {
         };
         return "";
     }
+    static const char* const ATTRIBUTE_KEY_NAMES[] = { "", "l", "center", "ncols", "nrows", "lang", "enum", "noenum" };
+
+    ATTRIBUTE_KEY attribute_key(std::string_view key) {
+        for (int i = ATTRIBUTE_L;i <= ATTRIBUTE_NOENUM;i++) {
+            if (key == ATTRIBUTE_KEY_NAMES[i])
+                return (ATTRIBUTE_KEY)i;
+        }
+        return ATTRIBUTE_OTHER;
+    }
+    const char* attribute_key_to_name(ATTRIBUTE_KEY key) {
+        return ATTRIBUTE_KEY_NAMES[key];
+    }
+
+    Attributes& Attributes::operator=(const Attributes& other) {
+        if (this == &other)
+            return *this;
+        m_size = other.m_size;
+        if (m_size <= INLINE_CAPACITY) {
+            std::copy(other.m_inline, other.m_inline + m_size, m_inline);
+            m_spilled.clear();
+        }
+        else {
+            m_spilled = other.m_spilled;
+        }
+        if (other.m_storage == nullptr) {
+            m_storage.reset();
+            return *this;
+        }
+        m_storage = std::make_unique<std::string>(*other.m_storage);
+        rebase(other.m_storage->data(), (SIZE)other.m_storage->size());
+        return *this;
+    }
+
+    const std::string_view* Attributes::find(std::string_view key) const {
+        for (const auto& attribute : *this) {
+            if (attribute.key == key)
+                return &attribute.value;
+        }
+        return nullptr;
+    }
+
+    const std::string_view* Attributes::find(ATTRIBUTE_KEY id) const {
+        for (const auto& attribute : *this) {
+            if (attribute.id == id)
+                return &attribute.value;
+        }
+        return nullptr;
+    }
+
+    void Attributes::clear() {
+        m_size = 0;
+        m_spilled.clear();
+        if (m_storage != nullptr)
+            m_storage->clear();
+    }
+
+    void Attributes::set(std::string_view key, std::string_view value, bool copy_key, bool copy_value) {
+        if (copy_key)
+            key = store(key);
+        if (copy_value)
+            value = store(value);
+        Attribute* attributes = data();
+        for (SIZE i = 0;i < m_size;i++) {
+            if (attributes[i].key == key) {
+                attributes[i].value = value;
+                return;
+            }
+        }
+        Attribute attribute{ attribute_key(key), key, value };
+        if (m_size < INLINE_CAPACITY) {
+            m_inline[m_size++] = attribute;
+            return;
+        }
+        if (m_size == INLINE_CAPACITY)
+            m_spilled.assign(m_inline, m_inline + INLINE_CAPACITY);
+        m_spilled.push_back(attribute);
+        m_size++;
+    }
+
+    std::string_view Attributes::store(std::string_view str) {
+        if (m_storage == nullptr)
+            m_storage = std::make_unique<std::string>();
+        const char* old_data = m_storage->data();
+        SIZE old_size = (SIZE)m_storage->size();
+        m_storage->append(str);
+        if (m_storage->data() != old_data)
+            rebase(old_data, old_size);
+        return std::string_view(m_storage->data() + old_size, str.size());
+    }
+
+    void Attributes::rebase(const char* old_data, SIZE old_size) {
+        const char* new_data = m_storage->data();
+        auto move_view = [&](std::string_view& view) {
+            if (view.data() >= old_data && view.data() + view.size() <= old_data + old_size && !view.empty())
+                view = std::string_view(new_data + (view.data() - old_data), view.size());
+        };
+        Attribute* attributes = data();
+        for (SIZE i = 0;i < m_size;i++) {
+            move_view(attributes[i].key);
+            move_view(attributes[i].value);
+        }
+    }
 }
\ No newline at end of file
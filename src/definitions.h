@@ -1,17 +1,23 @@
 #pragma once
 
-#include <unordered_map>
 #include <vector>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <variant>
 
 namespace AB {
     typedef unsigned int SIZE;
     typedef int OFFSET;
     typedef char CHAR;
 
+    /* Maximum nesting of the blocks (a list item counts for two levels, the list and
+     * the item). Deeper blocks are read as the text of a paragraph, so that adversarial
+     * inputs don't cost more per line and don't exhaust the stack of the threads */
+#ifndef RECURSE_LIMIT
 #define RECURSE_LIMIT 32
+#endif
 
     /* A block represents a part of the herarchy like a paragraph
      * or a list
@@ -92,17 +98,110 @@ namespace AB {
         OFFSET post = 0;
     };
 
-    typedef std::unordered_map<std::string, std::string> Attributes;
+    /* Non-owning view on contiguous boundaries, only valid during the call
+     * of the callback which received it */
+    struct BoundariesView {
+        const Boundaries* ptr = nullptr;
+        SIZE count = 0;
+
+        BoundariesView() = default;
+        BoundariesView(const Boundaries* ptr, SIZE count): ptr(ptr), count(count) {}
+        BoundariesView(const std::vector<Boundaries>& bounds): ptr(bounds.data()), count((SIZE)bounds.size()) {}
+
+        const Boundaries* data() const { return ptr; }
+        const Boundaries* begin() const { return ptr; }
+        const Boundaries* end() const { return ptr + count; }
+        SIZE size() const { return count; }
+        bool empty() const { return count == 0; }
+        const Boundaries& operator[](SIZE i) const { return ptr[i]; }
+        const Boundaries& front() const { return ptr[0]; }
+        const Boundaries& back() const { return ptr[count - 1]; }
+    };
+
+    /* Keys of attributes which are common enough to be compared as integers */
+    enum ATTRIBUTE_KEY {
+        ATTRIBUTE_OTHER = 0, /* Any key which is not interned */
+
+        ATTRIBUTE_L,
+        ATTRIBUTE_CENTER,
+        ATTRIBUTE_NCOLS,
+        ATTRIBUTE_NROWS,
+        ATTRIBUTE_LANG,
+        ATTRIBUTE_ENUM,
+        ATTRIBUTE_NOENUM
+    };
+
+    /* Returns ATTRIBUTE_OTHER if key is not interned */
+    ATTRIBUTE_KEY attribute_key(std::string_view key);
+    const char* attribute_key_to_name(ATTRIBUTE_KEY key);
+
+    struct Attribute {
+        ATTRIBUTE_KEY id = ATTRIBUTE_OTHER;
+        std::string_view key;
+        std::string_view value;
+    };
+
+    /**
+     * Attributes of a block or a span, in the order of the text
+     *
+     * The keys and values are views on the parsed text, they are only valid as long
+     * as the text is. The few keys and values which are not contiguous in the text
+     * (backslashes and the spaces inside a key are skipped) are copied in a storage
+     * owned by the attributes.
+     * The first attributes are stored inline, there is no allocation for the usual
+     * `{{l:name}}` or `{{center,ncols=2}}`
+     */
+    class Attributes {
+    public:
+        Attributes() = default;
+        Attributes(const Attributes& other) { *this = other; }
+        Attributes& operator=(const Attributes& other);
+
+        const Attribute* begin() const { return data(); }
+        const Attribute* end() const { return data() + m_size; }
+        SIZE size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        const Attribute& operator[](SIZE i) const { return data()[i]; }
+
+        /* Returns the value of key, nullptr if there is none */
+        const std::string_view* find(std::string_view key) const;
+        const std::string_view* find(ATTRIBUTE_KEY id) const;
+        SIZE count(std::string_view key) const { return find(key) != nullptr; }
+
+        void clear();
+        /**
+         * Sets the value of key, replacing the previous one if any
+         *
+         * key and value are copied in the storage of the attributes if asked,
+         * otherwise they must stay valid as long as the attributes are used
+         */
+        void set(std::string_view key, std::string_view value, bool copy_key = false, bool copy_value = false);
+
+    private:
+        static const SIZE INLINE_CAPACITY = 4;
+
+        Attribute* data() { return (m_size <= INLINE_CAPACITY) ? m_inline : m_spilled.data(); }
+        const Attribute* data() const { return (m_size <= INLINE_CAPACITY) ? m_inline : m_spilled.data(); }
+        std::string_view store(std::string_view str);
+        /* Moves the views on the storage from old_data to the current storage */
+        void rebase(const char* old_data, SIZE old_size);
+
+        Attribute m_inline[INLINE_CAPACITY];
+        std::vector<Attribute> m_spilled;
+        SIZE m_size = 0;
+        std::unique_ptr<std::string> m_storage;
+    };
 
-    struct BlockDetail {};
-    typedef std::shared_ptr<BlockDetail> BlockDetailPtr;
+    /* The strings of the details are views on the parsed text, or on a storage
+     * of the parser for the few ones which skip chars of the text. Like the
+     * boundaries, they are only valid during the call of the callback */
 
-    struct BlockCodeDetail: public BlockDetail {
-        std::string lang;
-        int num_ticks;
+    struct BlockCodeDetail {
+        std::string_view lang;
+        int num_ticks = 0;
     };
 
-    struct BlockOlDetail: public BlockDetail {
+    struct BlockOlDetail {
         enum OL_TYPE { OL_NUMERIC, OL_ALPHABETIC, OL_ROMAN };
         char pre_marker;
         char post_marker;
@@ -110,59 +209,64 @@ namespace AB {
         OL_TYPE type;
     };
 
-    struct BlockUlDetail: public BlockDetail {
+    struct BlockUlDetail {
         char marker;
     };
 
-    struct BlockLiDetail: public BlockDetail {
+    struct BlockLiDetail {
         enum TASK_STATE { TASK_EMPTY, TASK_FAIL, TASK_SUCCESS };
-        bool is_task;
-        std::string number;
-        TASK_STATE task_state;
+        bool is_task = false;
+        std::string_view number;
+        TASK_STATE task_state = TASK_EMPTY;
         int level = 0;
     };
 
-    struct BlockDefDetail: public BlockDetail {
+    struct BlockDefDetail {
         enum DEF_TYPE { DEF_FOOTNOTE, DEF_CITATION, DEF_LINK };
-        std::string name;
+        std::string_view name;
         DEF_TYPE definition_type;
     };
 
-    struct BlockDivDetail: public BlockDetail {
-        std::string name;
+    struct BlockDivDetail {
+        std::string_view name;
     };
 
-    struct BlockHDetail: public BlockDetail {
+    struct BlockHDetail {
         unsigned char level; /* Header level (1 to 6) */
     };
     // TODO, tables
 
-    struct SpanDetail {};
-    struct SpanADetail: public SpanDetail {
-        std::string href;
+    /* Detail of a block, std::monostate for the blocks without one */
+    typedef std::variant<std::monostate, BlockCodeDetail, BlockOlDetail, BlockUlDetail, BlockLiDetail,
+        BlockDefDetail, BlockDivDetail, BlockHDetail> BlockDetail;
+
+    struct SpanADetail {
+        std::string_view href;
         bool alias = false;
     };
-    struct SpanImgDetail: public SpanDetail {
-        std::string src;
-        std::string title;
+    struct SpanImgDetail {
+        std::string_view src;
+        std::string_view title;
         bool alias = false;
     };
-    struct SpanRefDetail: public SpanDetail {
-        std::string name;
+    struct SpanRefDetail {
+        std::string_view name;
         bool inserted = false;
     };
-    typedef std::shared_ptr<SpanDetail> SpanDetailPtr;
+
+    /* Detail of a span, std::monostate for the spans without one */
+    typedef std::variant<std::monostate, SpanADetail, SpanImgDetail, SpanRefDetail> SpanDetail;
 
 
     /* =================
      * Parsing functions
      * ================= */
 
-    typedef std::function<bool(BLOCK_TYPE type, const std::vector<Boundaries>& bounds, const Attributes& attributes, std::shared_ptr<BlockDetail> detail)> BlockFct;
+    typedef std::function<bool(BLOCK_TYPE type, BoundariesView bounds, const Attributes& attributes, const BlockDetail& detail)> BlockFct;
     typedef std::function<bool(BLOCK_TYPE type)> LeaveBlockFct;
-    typedef std::function<bool(SPAN_TYPE type, const std::vector<Boundaries>& bounds, const Attributes& attributes, std::shared_ptr<SpanDetail> detail)> SpanFct;
+    typedef std::function<bool(SPAN_TYPE type, BoundariesView bounds, const Attributes& attributes, const SpanDetail& detail)> SpanFct;
     typedef std::function<bool(SPAN_TYPE type)> LeaveSpanFct;
-    typedef std::function<bool(TEXT_TYPE type, const std::vector<Boundaries>& bounds)> TextFct;
+    typedef std::function<bool(TEXT_TYPE type, BoundariesView bounds)> TextFct;
 
     struct Parser {
         BlockFct enter_block;
@@ -172,4 +276,35 @@ namespace AB {
         TextFct text;
     };
 
+    /* ===================
+     * Incremental parsing
+     * =================== */
+
+    /* Describes a modification of the text: the bytes [beg, old_end) of
+     * the previous text have been replaced by the bytes [beg, new_end)
+     * of the new text */
+    struct TextEdit {
+        OFFSET beg = 0;
+        OFFSET old_end = 0;
+        OFFSET new_end = 0;
+    };
+
+    /* Informations kept after parsing, which allow to only re-parse
+     * the top-level blocks affected by an edit */
+    struct ParseResult {
+        /* Parsed window of the text */
+        OFFSET start = 0;
+        OFFSET end = 0;
+        /* Sorted offsets of the lines from which the parsing can be restarted
+         * without knowing anything about the text before (a new DOC-level block
+         * which is not influenced by the indentation of the block above) */
+        std::vector<OFFSET> restart_offsets;
+        /* Line numbers of the restart offsets */
+        std::vector<int> restart_lines;
+        /* Range of the text for which events have been sent to the caller
+         * during the last parse or re-parse */
+        OFFSET reparsed_beg = 0;
+        OFFSET reparsed_end = 0;
+    };
+
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+#include "mapped_file.h"
+
+namespace AB {
+    /* ======
+     * Events
+     * ====== */
+
+    enum EVENT_TYPE {
+        EVENT_ENTER_BLOCK,
+        EVENT_LEAVE_BLOCK,
+        EVENT_ENTER_SPAN,
+        EVENT_LEAVE_SPAN,
+        EVENT_TEXT
+    };
+
+    /**
+     * An event is a call to one of the callbacks of the visitor
+     *
+     * The pointers are owned by the parser and are only valid
+     * during the processing of the batch containing the event
+     */
+    struct Event {
+        EVENT_TYPE e_type;
+        /* BLOCK_TYPE, SPAN_TYPE or TEXT_TYPE, depending on e_type */
+        int type;
+        BoundariesView bounds;
+        const Attributes* attributes = nullptr;
+        const BlockDetail* block_detail = nullptr;
+        const SpanDetail* span_detail = nullptr;
+    };
+
+    /**
+     * Called with the events of the DOC-level blocks each time these are finished
+     * (or of their closed blocks, see ParserSession::max_unsent_blocks)
+     *
+     * Should return false to stop the parsing
+     */
+    typedef bool (*BatchFct)(const std::vector<Event>& events, void* user_data);
+
+    class ThreadPool;
+
+    /**
+     * Parsing functions which send the events in batches, see parse() and reparse()
+     *
+     * text must be readable up to end included (as the '\0' of a std::string)
+     */
+    bool parse_batches(const char* text, OFFSET start, OFFSET end, BatchFct batch_fct, void* user_data, ParseResult* result = nullptr, int start_line = -1, ThreadPool* pool = nullptr);
+    bool reparse_batches(const char* text, const ParseResult& previous, const TextEdit& edit, BatchFct batch_fct, void* user_data, ParseResult* result);
+
+    /**
+     * Sends the event to the visitor, which should have the following member functions:
+     *
+     *     bool enter_block(BLOCK_TYPE type, BoundariesView bounds, const Attributes& attributes, const BlockDetail& detail);
+     *     bool leave_block(BLOCK_TYPE type);
+     *     bool enter_span(SPAN_TYPE type, BoundariesView bounds, const Attributes& attributes, const SpanDetail& detail);
+     *     bool leave_span(SPAN_TYPE type);
+     *     bool text(TEXT_TYPE type, BoundariesView bounds);
+     *
+     * The calls are resolved at compile time, so they can be inlined.
+     * Returning false stops the parsing
+     */
+    template<typename Visitor>
+    inline bool dispatch_event(Visitor& visitor, const Event& event) {
+        switch (event.e_type) {
+        case EVENT_ENTER_BLOCK:
+            return visitor.enter_block((BLOCK_TYPE)event.type, event.bounds, *event.attributes, *event.block_detail);
+        case EVENT_LEAVE_BLOCK:
+            return visitor.leave_block((BLOCK_TYPE)event.type);
+        case EVENT_ENTER_SPAN:
+            return visitor.enter_span((SPAN_TYPE)event.type, event.bounds, *event.attributes, *event.span_detail);
+        case EVENT_LEAVE_SPAN:
+            return visitor.leave_span((SPAN_TYPE)event.type);
+        case EVENT_TEXT:
+            return visitor.text((TEXT_TYPE)event.type, event.bounds);
+        }
+        return true;
+    }
+
+    template<typename Visitor>
+    bool dispatch_batch(const std::vector<Event>& events, void* user_data) {
+        Visitor& visitor = *static_cast<Visitor*>(user_data);
+        for (const auto& event : events) {
+            if (!dispatch_event(visitor, event))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Same as parse(text, start, end, parser, result, start_line, pool), but the
+     * events are sent to the member functions of visitor (see dispatch_event)
+    */
+    template<typename Visitor>
+    bool parse(const std::string* text, OFFSET start, OFFSET end, Visitor& visitor, ParseResult* result = nullptr, int start_line = -1, ThreadPool* pool = nullptr) {
+        return parse_batches(text->data(), start, end, &dispatch_batch<Visitor>, &visitor, result, start_line, pool);
+    }
+
+    /* Same as above, for a text which is not in a std::string (e.g. a MappedFile) */
+    template<typename Visitor>
+    bool parse(const char* text, OFFSET start, OFFSET end, Visitor& visitor, ParseResult* result = nullptr, int start_line = -1, ThreadPool* pool = nullptr) {
+        return parse_batches(text, start, end, &dispatch_batch<Visitor>, &visitor, result, start_line, pool);
+    }
+
+    /**
+     * Same as parse_file(path, parser, result), but the events are
+     * sent to the member functions of visitor (see dispatch_event)
+    */
+    template<typename Visitor>
+    bool parse_file(const std::string& path, Visitor& visitor, ParseResult* result = nullptr) {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+        parse_batches(file.data(), 0, (OFFSET)file.size(), &dispatch_batch<Visitor>, &visitor, result);
+        return true;
+    }
+
+    /**
+     * Same as reparse(text, previous, edit, parser, result), but the events are
+     * sent to the member functions of visitor (see dispatch_event)
+    */
+    template<typename Visitor>
+    bool reparse(const std::string* text, const ParseResult& previous, const TextEdit& edit, Visitor& visitor, ParseResult* result) {
+        return reparse_batches(text->data(), previous, edit, &dispatch_batch<Visitor>, &visitor, result);
+    }
+
+    /* Visitor calling the std::function callbacks of a Parser */
+    struct ParserVisitor {
+        const Parser* parser;
+
+        bool enter_block(BLOCK_TYPE type, BoundariesView bounds, const Attributes& attributes, const BlockDetail& detail) {
+            return parser->enter_block(type, bounds, attributes, detail);
+        }
+        bool leave_block(BLOCK_TYPE type) {
+            return parser->leave_block(type);
+        }
+        bool enter_span(SPAN_TYPE type, BoundariesView bounds, const Attributes& attributes, const SpanDetail& detail) {
+            return parser->enter_span(type, bounds, attributes, detail);
+        }
+        bool leave_span(SPAN_TYPE type) {
+            return parser->leave_span(type);
+        }
+        bool text(TEXT_TYPE type, BoundariesView bounds) {
+            return parser->text(type, bounds);
+        }
+    };
+}
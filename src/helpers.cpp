@@ -101,7 +101,7 @@ namespace AB {
         return str;
     }
 
-    int roman_to_decimal(const std::string& str) {
+    int roman_to_decimal(std::string_view str) {
         if (str.empty())
             return 0;
 
@@ -118,7 +118,7 @@ namespace AB {
         res += roman_value(str[str.length() - 1]);
         return res;
     }
-    int alpha_to_decimal(const std::string& str) {
+    int alpha_to_decimal(std::string_view str) {
         int res = 0;
         int multiplier = 1;
         for (int i = (int)str.length() - 1;i >= 0;i--) {
@@ -138,7 +138,7 @@ namespace AB {
         }
         return res;
     }
-    bool validate_roman_enumeration(const std::string& str) {
+    bool validate_roman_enumeration(std::string_view str) {
         if (str.empty())
             return false;
 
@@ -222,7 +222,7 @@ namespace AB {
         }
         return true;
     }
-    bool validate_alpha_enumeration(const std::string& str, int max_length) {
+    bool validate_alpha_enumeration(std::string_view str, int max_length) {
         if (str.length() > max_length || str.length() == 0)
             return false;
 
@@ -1,14 +1,15 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace AB {
     std::string decimal_to_roman(int number, bool lower = false);
     std::string decimal_to_alpha(int number, bool lower = true);
 
-    int roman_to_decimal(const std::string& str);
-    int alpha_to_decimal(const std::string& str);
+    int roman_to_decimal(std::string_view str);
+    int alpha_to_decimal(std::string_view str);
 
-    bool validate_roman_enumeration(const std::string& str);
-    bool validate_alpha_enumeration(const std::string& str, int max_length = 3);
+    bool validate_roman_enumeration(std::string_view str);
+    bool validate_alpha_enumeration(std::string_view str, int max_length = 3);
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 #pragma once
 #include <string.h>
 #include <memory>
+#include <vector>
 
 #include "definitions.h"
+#include "events.h"
+#include "structural_index.h"
 #include "profiling.h"
 #include <iostream>
 
@@ -12,7 +15,7 @@ namespace AB {
        *****************/
 
        /* Character accessors. */
-#define CH(off)                 ((*ctx->text)[(off)])
+#define CH(off)                 (ctx->text[(off)])
 
      /* Character classification.
       * Note we assume ASCII compatibility of code points < 128 here. */
@@ -81,7 +84,38 @@ namespace AB {
             bool allow_attributes = true;
       };
 
+      /**
+       * Objects allocated by slabs which are never freed before the Slab
+       *
+       * The objects keep their addresses, and clear() keeps the slabs so that
+       * the objects (and the memory they own) are reused by the next add()
+       */
+      template<typename T>
+      class Slab {
+      public:
+            /* Number of objects given by add() since the last clear() */
+            SIZE size() const { return m_size; }
+            T* operator[](SIZE idx) const { return &m_slabs[idx / SLAB_SIZE][idx % SLAB_SIZE]; }
+            T* front() const { return (*this)[0]; }
+
+            /* Returns an object which may have been used before the last clear() */
+            T* add() {
+                  if (m_size == m_slabs.size() * SLAB_SIZE)
+                        m_slabs.emplace_back(new T[SLAB_SIZE]);
+                  return (*this)[m_size++];
+            }
+            void clear() { m_size = 0; }
+      private:
+            static const SIZE SLAB_SIZE = 64;
+
+            std::vector<std::unique_ptr<T[]>> m_slabs;
+            SIZE m_size = 0;
+      };
+
       struct Container;
+      class ThreadPool;
+      /* Memory reused by the span parsing, see parse_spans.cpp */
+      struct SpanBuffers;
       typedef std::shared_ptr<Container> ContainerPtr;
       struct Container {
             bool closed = false;
@@ -91,15 +125,42 @@ namespace AB {
             Attributes attributes;
 
             BLOCK_TYPE b_type;
-            std::shared_ptr<BlockDetail> detail;
+            BlockDetail detail;
             Container* parent = nullptr;
             std::vector<Container*> children;
             std::vector<Boundaries> content_boundaries;
             int last_non_empty_child_line = -1;
             int flag = 0;
             int indent = 0;
+            /* Index in ctx->span_buffers of the spans resolved concurrently, -1 if none */
+            int span_job = -1;
+            /* Entered by send_closed_blocks() before being finished */
+            bool entered = false;
+            /* Number of parents, up to DOC (see RECURSE_LIMIT) */
+            int depth = 0;
+
+            /* Resets the container as if it was new, but its vectors keep their memory */
+            void reset() {
+                  closed = false;
+                  erase_block = false;
+                  repeated_markers = RepeatedMarker{};
+                  attributes.clear();
+                  b_type = BLOCK_DOC;
+                  detail = BlockDetail();
+                  parent = nullptr;
+                  children.clear();
+                  content_boundaries.clear();
+                  last_non_empty_child_line = -1;
+                  flag = 0;
+                  indent = 0;
+                  span_job = -1;
+                  entered = false;
+                  depth = 0;
+            }
       };
 
+      typedef Slab<Container> ContainerSlab;
+
       /**************
       *** Context ***
       ***************/
@@ -108,20 +169,119 @@ namespace AB {
       */
       struct Context {
             /* Information given by the user */
-            const std::string* text;
+            /* Text of the document, followed by a '\0' (see MappedFile) */
+            const char* text;
             OFFSET start;
             OFFSET end;
-            const Parser* parser;
+            BatchFct batch_fct;
+            void* user_data;
+
+            /* Events of the DOC-level blocks which are not sent yet (see flush_events) */
+            std::vector<Event> events;
+            /* Arena storing the boundaries of the span and text events, one after the
+             * other in the order of the events */
+            std::vector<Boundaries> event_bounds;
+            /* Copies of the other data of the span events, reused from one batch to another */
+            Slab<Attributes> event_attributes;
+            Slab<SpanDetail> event_span_details;
+            /* Strings of the details which are not a range of the text (see view_without_escapes) */
+            Slab<std::string> detail_strings;
+            /* Attributes of the line being analysed, if it has any (see SegmentInfo) */
+            Attributes segment_attributes;
+            /* Set when the user returned false, no more events are sent */
+            bool stopped = false;
+
+            /* Streaming (see StreamParser): the text ends in the middle of the document,
+             * so neither the unfinished DOC-level blocks nor the end of DOC are sent */
+            bool partial = false;
+            /* The beginning of DOC has already been sent by a previous parse */
+            bool skip_doc_enter = false;
+            /* Number of batches to compute without sending them, because they
+             * have already been sent by a previous parse */
+            int skip_batches = 0;
+            /* Number of batches flushed since the last restart point */
+            int batches_since_restart = 0;
+            /* When interrupted, the rest of the document is sent by
+             * the caller, including the end of DOC (see parse_parallel) */
+            bool keep_doc_open = false;
 
-            std::vector<Container*> containers;
-            /* This allows us to reuse previously allocated
-             * memory */
-            std::vector<Container*>::iterator last_free_mem_it;
+            /* If not null, the spans of the leaf blocks of a batch
+             * are resolved concurrently (see ThreadPool) */
+            ThreadPool* pool = nullptr;
+            std::shared_ptr<SpanBuffers> span_buffers;
+
+            /* Containers of the parse, process_doc() uses its own if null */
+            ContainerSlab* containers = nullptr;
+            /* Index of the first container which can be reused, the containers
+             * of the DOC-level blocks already sent are reused by the next ones */
+            SIZE first_free_container = 0;
+            /* Containers of the blocks sent by send_closed_blocks(), reused before the
+             * ones after first_free_container */
+            std::vector<Container*> free_containers;
+            /* When more containers than this are used by an unfinished DOC-level block,
+             * its closed blocks are sent (see send_closed_blocks), 0 to never do it */
+            SIZE max_unsent_blocks = 0;
             Container* current_container;
             Container* above_container = nullptr;
+            /* DOC, its last child, the last child of this one, etc. They are the blocks of
+             * the previous line that the current one may continue, open_containers[i]
+             * being the one whose depth is i (see select_last_child_container) */
+            std::vector<Container*> open_containers;
+            /* Blocks being sent by enter_block(), with the index of their next child */
+            std::vector<std::pair<Container*, SIZE>> block_stack;
+
+            StructuralIndex structural_index;
+            /* Absolute line number of ctx->start */
+            int first_line_number = 0;
+            /* Offsets at which the lines begin, starting from the line of ctx->start */
+            std::vector<int> line_number_begs;
+            /* Index in line_number_begs of the last offset_to_line_number() lookup */
+            int last_line_number = 0;
+
+            /* Incremental parsing (see reparse) */
+            ParseResult* result = nullptr;
+            const ParseResult* previous = nullptr;
+            OFFSET edit_new_end = 0;
+            OFFSET edit_delta = 0;
+            /* Set when reaching a restart point after which the
+             * previous parse is still valid */
+            bool interrupted = false;
+      };
+
+      /* Parses the text of the context, see parser.cpp */
+      bool process_doc(Context* ctx);
 
-            std::vector<int> offset_to_line_number;
+      /**
+       * Memory kept by a ParserSession from one parse to another
+       *
+       * The buffers are moved into the Context of a parse by take_session_buffers(),
+       * and moved back with the memory they have grown by return_session_buffers()
+       */
+      struct SessionBuffers {
+            ContainerSlab containers;
+            std::vector<Container*> free_containers;
+            std::vector<Container*> open_containers;
+            std::vector<std::pair<Container*, SIZE>> block_stack;
+            /* Given to the Context of each parse, see ParserSession::max_unsent_blocks */
+            SIZE max_unsent_blocks = 0;
+            std::vector<Event> events;
+            std::vector<Boundaries> event_bounds;
+            Slab<Attributes> event_attributes;
+            Slab<SpanDetail> event_span_details;
+            Slab<std::string> detail_strings;
+            StructuralIndex structural_index;
             std::vector<int> line_number_begs;
+            std::shared_ptr<SpanBuffers> span_buffers;
+            /* Result being built by reparse_batches() */
+            ParseResult result;
       };
 
+      /* Does nothing if session is null, see parser.cpp */
+      void take_session_buffers(Context* ctx, SessionBuffers* session);
+      void return_session_buffers(Context* ctx, SessionBuffers* session);
+
+      /* Same as parse_batches() and reparse_batches(), with the
+       * buffers of a session if it is not null */
+      bool parse_batches(SessionBuffers* session, const char* text, OFFSET start, OFFSET end, BatchFct batch_fct, void* user_data, ParseResult* result, int start_line, ThreadPool* pool);
+      bool reparse_batches(SessionBuffers* session, const char* text, const ParseResult& previous, const TextEdit& edit, BatchFct batch_fct, void* user_data, ParseResult* result);
 }
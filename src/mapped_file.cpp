@@ -0,0 +1,82 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace AB {
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+#if defined(_WIN32)
+    bool MappedFile::open(const std::string& path) {
+        close();
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs)
+            return false;
+        m_fallback.assign((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+        m_data = m_fallback.data();
+        m_size = (SIZE)m_fallback.size();
+        return true;
+    }
+
+    void MappedFile::close() {
+        m_fallback.clear();
+        m_data = "";
+        m_size = 0;
+    }
+#else
+    bool MappedFile::open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        SIZE size = (SIZE)st.st_size;
+        if (size == 0) {
+            ::close(fd);
+            return true;
+        }
+
+        /* The parser may read one character past the end, like the '\0' of a std::string.
+         * The file is mapped over a zeroed region which has at least one more page */
+        SIZE page_size = (SIZE)sysconf(_SC_PAGESIZE);
+        SIZE mapped_size = (size / page_size + 1) * page_size;
+        void* region = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        void* ptr = mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED) {
+            munmap(region, mapped_size);
+            return false;
+        }
+        madvise(ptr, size, MADV_SEQUENTIAL);
+
+        m_data = static_cast<const char*>(ptr);
+        m_size = size;
+        m_mapped_size = mapped_size;
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (m_mapped_size > 0)
+            munmap(const_cast<char*>(m_data), m_mapped_size);
+        m_data = "";
+        m_size = 0;
+        m_mapped_size = 0;
+    }
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#include "definitions.h"
+
+namespace AB {
+    /**
+     * Read-only view on the content of a file, memory-mapped when
+     * the platform allows it (read in memory otherwise)
+     *
+     * Like a std::string, the text is followed by a '\0'
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /* Returns false if the file can't be opened */
+        bool open(const std::string& path);
+        void close();
+
+        const char* data() const { return m_data; }
+        SIZE size() const { return m_size; }
+    private:
+        const char* m_data = "";
+        SIZE m_size = 0;
+        /* Size of the mapping, 0 if nothing is mapped */
+        SIZE m_mapped_size = 0;
+        /* Content of the file when it can't be mapped */
+        std::string m_fallback;
+    };
+}
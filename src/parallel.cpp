@@ -0,0 +1,255 @@
+#include "parallel.h"
+#include "internal.h"
+
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <string.h>
+
+namespace AB {
+    /* Chunks smaller than this are not worth a thread */
+    static const OFFSET MIN_CHUNK_SIZE = 1 << 16;
+
+    /* Events of a chunk, copied so that they survive the parsing */
+    struct ChunkEvents {
+        struct Batch {
+            SIZE first_event;
+            SIZE num_events;
+            /* Number of restart points of the chunk when the batch was sent */
+            SIZE num_restart_points;
+        };
+
+        const char* text;
+        OFFSET start;
+        OFFSET end;
+        bool last;
+        /* Line numbers are relative to the start of the chunk
+         * until the number of lines before it is known */
+        int num_lines = 0;
+        int start_line = 0;
+
+        std::vector<Event> events;
+        std::vector<Batch> batches;
+        std::vector<Boundaries> bounds;
+        std::deque<Attributes> attributes;
+        std::deque<BlockDetail> block_details;
+        std::deque<SpanDetail> span_details;
+        /* Strings of the details which are not a range of the text */
+        std::deque<std::string> strings;
+        ParseResult result;
+    };
+
+    /* Returns str, copied in the chunk if it is not a view on the text,
+     * as the storage of the parser is released after the chunk */
+    static std::string_view keep_string(ChunkEvents* chunk, std::string_view str) {
+        if (str.empty() || (str.data() >= chunk->text && str.data() + str.size() <= chunk->text + chunk->end))
+            return str;
+        chunk->strings.emplace_back(str);
+        return chunk->strings.back();
+    }
+
+    static void keep_strings(ChunkEvents* chunk, BlockDetail& detail) {
+        if (auto d = std::get_if<BlockCodeDetail>(&detail))
+            d->lang = keep_string(chunk, d->lang);
+        else if (auto d = std::get_if<BlockDefDetail>(&detail))
+            d->name = keep_string(chunk, d->name);
+        else if (auto d = std::get_if<BlockDivDetail>(&detail))
+            d->name = keep_string(chunk, d->name);
+    }
+
+    static bool record_batch(const std::vector<Event>& events, void* user_data) {
+        ChunkEvents* chunk = static_cast<ChunkEvents*>(user_data);
+        chunk->batches.push_back({ (SIZE)chunk->events.size(), (SIZE)events.size(), (SIZE)chunk->result.restart_offsets.size() });
+        for (const auto& event : events) {
+            Event copy = event;
+            /* The pointers to the boundaries are set once the chunk is parsed */
+            chunk->bounds.insert(chunk->bounds.end(), event.bounds.begin(), event.bounds.end());
+            copy.bounds.ptr = nullptr;
+            if (event.attributes != nullptr) {
+                chunk->attributes.push_back(*event.attributes);
+                copy.attributes = &chunk->attributes.back();
+            }
+            if (event.block_detail != nullptr) {
+                chunk->block_details.push_back(*event.block_detail);
+                keep_strings(chunk, chunk->block_details.back());
+                copy.block_detail = &chunk->block_details.back();
+            }
+            if (event.span_detail != nullptr) {
+                chunk->span_details.push_back(*event.span_detail);
+                copy.span_detail = &chunk->span_details.back();
+            }
+            chunk->events.push_back(copy);
+        }
+        return true;
+    }
+
+    static void parse_chunk(const char* text, ChunkEvents* chunk) {
+        chunk->result.restart_offsets.push_back(chunk->start);
+        chunk->result.restart_lines.push_back(0);
+
+        Context ctx;
+        ctx.text = text;
+        ctx.start = chunk->start;
+        ctx.end = chunk->end;
+        ctx.batch_fct = &record_batch;
+        ctx.user_data = chunk;
+        ctx.result = &chunk->result;
+        ctx.skip_doc_enter = chunk->start > 0;
+        /* The last chunk sends its unfinished blocks and the end of DOC */
+        ctx.partial = !chunk->last;
+
+        process_doc(&ctx);
+
+        chunk->num_lines = (int)ctx.line_number_begs.size() - 1;
+        const Boundaries* ptr = chunk->bounds.data();
+        for (auto& event : chunk->events) {
+            event.bounds.ptr = ptr;
+            ptr += event.bounds.count;
+        }
+    }
+
+    /* Returns the beginning of the first line after a blank line which is after off,
+     * or end if there is none */
+    static OFFSET find_split_point(const char* text, OFFSET off, OFFSET end) {
+        while (off < end) {
+            const char* found = static_cast<const char*>(memchr(text + off, '\n', end - off));
+            if (found == nullptr)
+                return end;
+            off = (OFFSET)(found - text) + 1;
+            if (off < end && text[off] == '\n') {
+                while (off < end && text[off] == '\n')
+                    off++;
+                return off;
+            }
+        }
+        return end;
+    }
+
+    struct Replay {
+        BatchFct batch_fct;
+        void* user_data;
+        std::vector<Event> events;
+        std::vector<Boundaries> bounds;
+        SIZE num_sent = 0;
+    };
+
+    /**
+     * Sends the batches of the chunk from the first one, with absolute line numbers
+     *
+     * The batches sent after the last restart point of the chunk are not sent (except
+     * for the last chunk), they will be sent when parsing again from this point
+     */
+    static bool replay_batches(Replay* replay, const ChunkEvents& chunk, SIZE first_batch) {
+        SIZE num_points = (SIZE)chunk.result.restart_offsets.size();
+        for (SIZE i = first_batch;i < chunk.batches.size();i++) {
+            const auto& batch = chunk.batches[i];
+            if (!chunk.last && batch.num_restart_points == num_points)
+                break;
+            replay->events.assign(chunk.events.begin() + batch.first_event, chunk.events.begin() + batch.first_event + batch.num_events);
+            replay->bounds.clear();
+            for (const auto& event : replay->events) {
+                for (const auto& bound : event.bounds) {
+                    replay->bounds.push_back(bound);
+                    replay->bounds.back().line_number += chunk.start_line;
+                }
+            }
+            const Boundaries* ptr = replay->bounds.data();
+            for (auto& event : replay->events) {
+                event.bounds.ptr = ptr;
+                ptr += event.bounds.count;
+            }
+            replay->num_sent++;
+            if (!replay->batch_fct(replay->events, replay->user_data))
+                return false;
+        }
+        return true;
+    }
+
+    bool parse_parallel_batches(const char* text, OFFSET end, BatchFct batch_fct, void* user_data, int num_threads) {
+        if (num_threads <= 1 || end < 2 * MIN_CHUNK_SIZE)
+            return parse_batches(text, 0, end, batch_fct, user_data, nullptr, 0);
+        num_threads = std::min(num_threads, (int)(end / MIN_CHUNK_SIZE));
+
+        /* Guess the chunks */
+        std::vector<ChunkEvents> chunks;
+        OFFSET chunk_start = 0;
+        for (int i = 1;i <= num_threads && chunk_start < end;i++) {
+            OFFSET chunk_end = (i == num_threads) ? end : find_split_point(text, std::max(chunk_start, (OFFSET)((int64_t)end * i / num_threads)), end);
+            chunks.emplace_back();
+            chunks.back().text = text;
+            chunks.back().start = chunk_start;
+            chunks.back().end = chunk_end;
+            chunk_start = chunk_end;
+        }
+        chunks.back().last = true;
+        for (SIZE i = 0;i + 1 < chunks.size();i++)
+            chunks[i].last = false;
+
+        std::vector<std::thread> threads;
+        for (SIZE i = 1;i < chunks.size();i++)
+            threads.emplace_back(parse_chunk, text, &chunks[i]);
+        parse_chunk(text, &chunks[0]);
+        for (auto& thread : threads)
+            thread.join();
+
+        /* Restart points found by the chunks, except their guessed starts */
+        ParseResult guessed;
+        for (auto& chunk : chunks) {
+            chunk.start_line = (&chunk == &chunks.front()) ? 0 : (&chunk - 1)->start_line + (&chunk - 1)->num_lines;
+            for (SIZE i = 0;i < chunk.result.restart_offsets.size();i++) {
+                if (chunk.result.restart_offsets[i] != chunk.start)
+                    guessed.restart_offsets.push_back(chunk.result.restart_offsets[i]);
+            }
+        }
+
+        Replay replay{ batch_fct, user_data };
+        /* The first chunk is right until its unfinished blocks */
+        SIZE chunk_idx = 0;
+        if (!replay_batches(&replay, chunks[0], 0))
+            return true;
+        /* The beginning of DOC is in the first batch */
+        bool doc_entered = replay.num_sent > 0;
+        while (!chunks[chunk_idx].last) {
+            const ChunkEvents& chunk = chunks[chunk_idx];
+            /* Parse again from the last restart point of the chunk, until reaching a restart
+             * point of a following chunk. From there, the chunk is in sync */
+            ParseResult result;
+            result.restart_offsets.push_back(chunk.result.restart_offsets.back());
+            result.restart_lines.push_back(chunk.start_line + chunk.result.restart_lines.back());
+
+            Context ctx;
+            ctx.text = text;
+            ctx.start = result.restart_offsets.back();
+            ctx.end = end;
+            ctx.first_line_number = result.restart_lines.back();
+            ctx.batch_fct = batch_fct;
+            ctx.user_data = user_data;
+            ctx.result = &result;
+            ctx.previous = &guessed;
+            ctx.edit_new_end = chunk.end;
+            ctx.skip_doc_enter = doc_entered;
+            ctx.keep_doc_open = true;
+
+            process_doc(&ctx);
+
+            if (ctx.stopped || !ctx.interrupted)
+                return true;
+            /* Blocks have been sent before the interruption */
+            doc_entered = true;
+
+            OFFSET sync = result.reparsed_end;
+            while (chunks[chunk_idx].end <= sync)
+                chunk_idx++;
+            const ChunkEvents& next = chunks[chunk_idx];
+            auto point_it = std::lower_bound(next.result.restart_offsets.begin(), next.result.restart_offsets.end(), sync);
+            SIZE num_points = (SIZE)(point_it - next.result.restart_offsets.begin()) + 1;
+            /* Skip the batches sent before the restart point */
+            SIZE first_batch = 0;
+            while (first_batch < next.batches.size() && next.batches[first_batch].num_restart_points < num_points)
+                first_batch++;
+            if (!replay_batches(&replay, next, first_batch))
+                return true;
+        }
+        return true;
+    }
+}
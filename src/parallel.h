@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "definitions.h"
+#include "events.h"
+
+namespace AB {
+    /* ================
+     * Parallel parsing
+     * ================ */
+
+    /**
+     * Parses the text between 0 and end on num_threads threads, and sends the
+     * events in the order of the document, identical to the ones of a serial parse
+     *
+     * The text is cut in chunks after blank lines, and the chunks are parsed
+     * concurrently from these guessed starts. The events of a chunk are only kept
+     * from the first restart point (see ParseResult) on which the serial parse would
+     * also have restarted, the text before it is parsed again in order.
+     *
+     * The events are sent from the calling thread, once all the chunks are parsed
+     */
+    bool parse_parallel_batches(const char* text, OFFSET end, BatchFct batch_fct, void* user_data, int num_threads);
+
+    /**
+     * Same as parse_parallel(text, parser, num_threads), but the events are
+     * sent to the member functions of visitor (see dispatch_event)
+    */
+    template<typename Visitor>
+    bool parse_parallel(const std::string* text, Visitor& visitor, int num_threads) {
+        return parse_parallel_batches(text->data(), (OFFSET)text->length(), &dispatch_batch<Visitor>, &visitor, num_threads);
+    }
+}
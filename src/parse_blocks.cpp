@@ -3,6 +3,8 @@
 #include "parse_commons.h"
 #include "internal.h"
 
+#include <algorithm>
+
 namespace AB {
     static const int LIST_OPENER = 0x1;
     static const int CODE_OPENER = 0x2;
@@ -32,12 +34,14 @@ namespace AB {
         int above_list_depth = 0;
         bool blank_line = true;
         bool skip_segment = false;
-        std::string acc; /* Accumulator */
+        /* Name of a DEF, DIV or CODE block, or number of an ordered LI (see view_without_escapes) */
+        std::string_view name;
         bool close_block = false;
         bool no_content_after = false;
         int count = 0; /* Repeated marker counts */
 
-        Attributes attributes;
+        /* Only set when the line has attributes, on ctx->segment_attributes */
+        const Attributes* attributes = nullptr;
 
         // List information
         char li_pre_marker = 0;
@@ -57,7 +61,7 @@ namespace AB {
     /**
      * Verifies if a str can be converted into a positiv number
     */
-    bool verify_positiv_number(const std::string& str) {
+    bool verify_positiv_number(std::string_view str) {
         if (str.empty())
             return false;
         if (str.length() == 1 && ISDIGIT_(str[0]))
@@ -76,7 +80,8 @@ namespace AB {
         return out;
     }
     static OFFSET find_next_line_off(Context* ctx, OFFSET off) {
-        OFFSET current_line_number = ctx->offset_to_line_number[off];
+        /* Index of the line in line_number_begs */
+        OFFSET current_line_number = offset_to_line_number(ctx, off) - ctx->first_line_number;
         if (current_line_number + 1 >= ctx->line_number_begs.size())
             return ctx->end;
         else
@@ -95,12 +100,16 @@ namespace AB {
     *** Parsing ***
     ***************/
 
+    /* Moves above_container to its last child, which is the next one in ctx->open_containers */
     static void select_last_child_container(Context* ctx) {
         if (ctx->above_container != nullptr) {
-            if (!ctx->above_container->children.empty()) {
-                ctx->above_container = ctx->above_container->children.back();
+            const auto& open_containers = ctx->open_containers;
+            SIZE depth = ctx->above_container->depth + 1;
+            if (depth < open_containers.size()) {
+                ctx->above_container = open_containers[depth];
+                /* A list always has an item */
                 if (ctx->above_container->b_type == BLOCK_UL || ctx->above_container->b_type == BLOCK_OL) {
-                    ctx->above_container = ctx->above_container->children.back();
+                    ctx->above_container = open_containers[depth + 1];
                 }
                 ctx->current_container = ctx->above_container;
             }
@@ -112,8 +121,21 @@ namespace AB {
 
     // === Analysing ===
 
+    /**
+     * Returns the first offset in [off, end) of a marker or of a backslash, or end
+     * if there is none. The other characters of the line are verbatim content
+    */
+    static OFFSET find_marker_or_escape(Context* ctx, OFFSET off, OFFSET end, char marker) {
+        if (off >= end)
+            return off;
+        const char* found = static_cast<const char*>(memchr(ctx->text + off, marker, end - off));
+        OFFSET next = (found == nullptr) ? end : (OFFSET)(found - ctx->text);
+        const char* escape = static_cast<const char*>(memchr(ctx->text + off, '\\', next - off));
+        return (escape == nullptr) ? next : (OFFSET)(escape - ctx->text);
+    }
+
     static void analyse_make_p(Context* ctx, OFFSET off, OFFSET* end, SegmentInfo* seg) {
-        seg->attributes.clear();
+        seg->attributes = nullptr;
         seg->b_bounds.pre = off;
         seg->b_bounds.beg = off;
         seg->flags = P_OPENER;
@@ -136,17 +158,46 @@ namespace AB {
             return 3;
     }
 
-    static inline void get_name_and_attributes(Context* ctx, OFFSET* off, std::string& name, Attributes& attributes) {
+    /* Reads the attributes at off (after the "{{") in ctx->segment_attributes */
+    static inline void read_segment_attributes(Context* ctx, OFFSET* off, SegmentInfo* seg) {
+        ctx->segment_attributes = parse_attributes(ctx, off);
+        seg->attributes = (ctx->segment_attributes.empty()) ? nullptr : &ctx->segment_attributes;
+    }
+
+    static inline void get_name_and_attributes(Context* ctx, OFFSET* off, SegmentInfo* seg) {
+        std::string_view& name = seg->name;
+        OFFSET name_beg = -1;
+        OFFSET name_end = -1;
+        bool contiguous = true;
         for (;(SIZE)*off < ctx->end && CH(*off) != '\n';(*off)++) {
             if (CH(*off) == '{' && CH(*off + 1) == '{') {
                 *off += 2;
-                attributes = parse_attributes(ctx, off);
+                read_segment_attributes(ctx, off, seg);
                 break;
             }
             else if (ISWHITESPACE(*off))
                 continue;
-            else
-                name += CH(*off);
+            if (name_beg < 0)
+                name_beg = *off;
+            else if (name_end != *off)
+                contiguous = false;
+            name_end = *off + 1;
+        }
+        if (name_beg < 0) {
+            name = std::string_view();
+        }
+        else if (contiguous) {
+            name = std::string_view(ctx->text + name_beg, name_end - name_beg);
+        }
+        else {
+            /* The whitespace inside the name is skipped */
+            std::string* copy = ctx->detail_strings.add();
+            copy->clear();
+            for (OFFSET i = name_beg;i < name_end;i++) {
+                if (!ISWHITESPACE(i))
+                    *copy += CH(i);
+            }
+            name = *copy;
         }
     }
 
@@ -188,8 +239,8 @@ namespace AB {
             tmp_off++;
             if (CH(tmp_off) == '{') {
                 tmp_off++;
-                seg->attributes = parse_attributes(ctx, &tmp_off);
-                if (seg->attributes.empty()) {
+                read_segment_attributes(ctx, &tmp_off, seg);
+                if (seg->attributes == nullptr) {
                     non_authorized_text_after = true;
                 }
             }
@@ -216,7 +267,7 @@ namespace AB {
         *seg = SegmentInfo();
 
         seg->end = find_next_line_off(ctx, off);
-        seg->line_number = ctx->offset_to_line_number[off];
+        seg->line_number = offset_to_line_number(ctx, off);
         OFFSET this_segment_end = seg->end;
         Container* above_container = ctx->above_container;
 
@@ -253,7 +304,8 @@ namespace AB {
         }
 
         int whitespace_counter = 0;
-        std::string acc; // Acc is for accumulator
+        /* Beginning of the enumeration of a potential ordered list */
+        OFFSET enum_beg = off;
         enum SOLVED { NONE, PARTIAL, FULL };
         SOLVED b_solved = NONE;
 
@@ -262,8 +314,6 @@ namespace AB {
 
         // Segment analysis
         while (off < seg->end) {
-            acc += CH(off);
-
             /* Indent is useful for knowing when to move above_container (see explanations
              * in process_segment) in the case of lists or definitions. Here is an example:
              *
@@ -299,7 +349,7 @@ namespace AB {
             if (!(ISWHITESPACE(off) || CH(off) == '\n') && seg->blank_line) {
                 seg->blank_line = false;
                 seg->first_non_blank = off;
-                acc = CH(off);
+                enum_beg = off;
             }
 
             if (CH(off) == ' ') {
@@ -427,12 +477,13 @@ namespace AB {
                     break;
                 }
                 b_solved = PARTIAL;
-                acc.clear();
+                enum_beg = off + 1;
                 seg->flags |= LIST_OPENER;
                 seg->li_pre_marker = '(';
             }
             else if (ISANYOF2(off, ')', '.')) {
-                std::string str = acc.substr(0, acc.size() - 1);
+                /* An escaped char makes the enumeration invalid, so it is a range of the text */
+                std::string_view str(ctx->text + enum_beg, off - enum_beg);
                 if (str.length() > 0 && str.length() < 12 && CHECK_WS_OR_END(off + 1)
                     && !(seg->li_pre_marker == '(' && CH(off) == '.')) { // Potential list
                     // The validity of enumeration should still be checked
@@ -446,7 +497,7 @@ namespace AB {
                     seg->flags = LIST_OPENER;
                     b_solved = PARTIAL;
                     seg->li_post_marker = CH(off);
-                    acc = str;
+                    seg->name = str;
                     break;
                 }
                 else {
@@ -461,8 +512,7 @@ namespace AB {
                     break;
                 }
                 OFFSET start_off = off;
-                acc = "";
-                bool found_end = advance_until(ctx, &off, acc, ']');
+                bool found_end = advance_until(ctx, &off, ']');
                 if (!found_end || CH(off + 1) != ':' || off - start_off < 2) {
                     analyse_make_p(ctx, seg->start, &this_segment_end, seg);
                     break;
@@ -476,7 +526,7 @@ namespace AB {
                     seg->b_bounds.end = off + 2;
                     seg->b_bounds.post = off + 2;
                     this_segment_end = off + 2;
-                    seg->acc = acc;
+                    seg->name = view_without_escapes(ctx, start_off, off + 1);
                     break;
                 }
             }
@@ -494,8 +544,7 @@ namespace AB {
                     seg->b_bounds.post = seg->end;
                     seg->indent = 4 + whitespace_counter;
                     this_segment_end = seg->end;
-                    seg->acc = "";
-                    get_name_and_attributes(ctx, &off, seg->acc, seg->attributes);
+                    get_name_and_attributes(ctx, &off, seg);
                     break;
                 }
                 else {
@@ -507,7 +556,7 @@ namespace AB {
                 OFFSET tmp_off = off;
                 int count = count_marks(ctx, &off, '$');
                 /* Try to advance until the end of the line to see if the block is already closed */
-                advance_until(ctx, &off, acc, '$');
+                advance_until(ctx, &off, '$');
                 int closing = check_for_closing_delimiters(ctx, &off, seg, '$', 2, false, true, true);
                 if (CHECK_WS_BEFORE(tmp_off) && count == 2 && closing >= 0) {
                     seg->flags = LATEX_OPENER;
@@ -537,8 +586,7 @@ namespace AB {
                     seg->b_bounds.post = seg->end;
                     seg->count = count;
                     off += count;
-                    seg->acc = "";
-                    get_name_and_attributes(ctx, &off, seg->acc, seg->attributes);
+                    get_name_and_attributes(ctx, &off, seg);
                 }
                 else {
                     analyse_make_p(ctx, seg->start, &this_segment_end, seg);
@@ -547,11 +595,24 @@ namespace AB {
 
             }
             next_utf8_char(&off);
+            /* Inside a fenced block, the whitespaces only matter until the indent of the
+             * block above, then only the markers and the backslashes do */
+            if (repeated_markers.marker && !seg->blank_line && whitespace_counter >= local_indent)
+                off = find_marker_or_escape(ctx, off, seg->end, repeated_markers.marker);
         }
 
         if (!seg->blank_line && seg->flags == 0) {
             analyse_make_p(ctx, seg->start, &this_segment_end, seg);
         }
+        /* Blocks whose content would be too deep are read as text (see RECURSE_LIMIT). The block
+         * of the segment is next to the one above, or under the current one if there is none */
+        int depth = ctx->current_container->depth + (ctx->above_container == nullptr ? 1 : 0);
+        /* The content of a LI is under the list and the item */
+        int content_depth = depth + ((seg->flags & LIST_OPENER) ? 2 : 1);
+        if (seg->flags & (QUOTE_OPENER | LIST_OPENER | DIV_OPENER | DEFINITION_OPENER) && content_depth > RECURSE_LIMIT) {
+            seg->indent = 0;
+            analyse_make_p(ctx, seg->start, &this_segment_end, seg);
+        }
         if (whitespace_counter < local_indent && seg->first_non_blank - seg->start > get_allowed_ws(seg->flags)) {
             analyse_make_p(ctx, seg->start, &this_segment_end, seg);
         }
@@ -574,11 +635,11 @@ namespace AB {
             else {
                 /* Still need to verify if ordered list has valid enumeration
                  * Example: 'IM' is not a valid roman value */
-                if ((verify_positiv_number(acc) && acc.length() < 10)
-                    || validate_roman_enumeration(acc)
-                    || alpha_to_decimal(acc) > 0 && acc.length() < 4) {
+                std::string_view enumeration = seg->name;
+                if ((verify_positiv_number(enumeration) && enumeration.length() < 10)
+                    || validate_roman_enumeration(enumeration)
+                    || alpha_to_decimal(enumeration) > 0 && enumeration.length() < 4) {
                     b_solved = FULL;
-                    seg->acc = acc;
                     seg->type = BLOCK_OL;
                 }
                 else {
@@ -597,80 +658,189 @@ namespace AB {
     }
 
     // === Processing ===
+    /* Sends the block and the blocks under it, without recursion (see RECURSE_LIMIT) */
     bool enter_block(Context* ctx, Container* ptr) {
-        bool ret = true;
-        CHECK_AND_RET(ctx->parser->enter_block(ptr->b_type, ptr->content_boundaries, ptr->attributes, ptr->detail));
-        for (auto child : ptr->children) {
-            if (child->b_type == BLOCK_EMPTY)
+        auto& stack = ctx->block_stack;
+        stack.clear();
+        stack.push_back({ ptr, 0 });
+        /* Otherwise, send_closed_blocks() has entered it and removed the children it sent */
+        if (!ptr->entered)
+            emit_enter_block(ctx, ptr->b_type, ptr->content_boundaries, &ptr->attributes, &ptr->detail);
+        while (!stack.empty()) {
+            Container* block = stack.back().first;
+            SIZE child_idx = stack.back().second++;
+            if (child_idx < block->children.size()) {
+                Container* child = block->children[child_idx];
+                if (child->b_type == BLOCK_EMPTY)
+                    continue;
+                if (!child->entered)
+                    emit_enter_block(ctx, child->b_type, child->content_boundaries, &child->attributes, &child->detail);
+                stack.push_back({ child, 0 });
                 continue;
-            CHECK_AND_RET(enter_block(ctx, child));
-        }
-        if (is_leaf_block(ptr->b_type)) {
-            parse_spans(ctx, ptr);
+            }
+            if (is_leaf_block(block->b_type)) {
+                parse_spans(ctx, block);
+            }
+            emit_leave_block(ctx, block->b_type);
+            stack.pop_back();
         }
-        CHECK_AND_RET(ctx->parser->leave_block(ptr->b_type));
-        return ret;
-    abort:
-        return ret;
+        return true;
     }
 
     bool send_previous_blocks(Context* ctx) {
         bool ret = true;
-        Container* root = ctx->containers.front();
+        Container* root = ctx->containers->front();
+        if (ctx->pool != nullptr)
+            resolve_spans_concurrently(ctx, root);
         for (auto child : root->children)
             CHECK_AND_RET(enter_block(ctx, child));
+        /* Must be sent before the containers are reused */
+        CHECK_AND_RET(flush_events(ctx));
         root->children.clear();
+        ctx->open_containers.resize(1);
         ctx->above_container = root;
-        ctx->last_free_mem_it = ctx->containers.begin() + 1;
-        /* Reset memory for all "freed" memory */
-        for (auto it = ctx->last_free_mem_it; it != ctx->containers.end();it++) {
-            (*it)->children.clear();
-            (*it)->closed = false;
-            (*it)->content_boundaries.clear();
-            (*it)->repeated_markers = RepeatedMarker{};
-            (*it)->last_non_empty_child_line = -1;
+        /* The containers are reset when add_container() reuses them, so that sending
+         * a small block doesn't cost as much as the largest one sent before */
+        ctx->first_free_container = 1;
+        ctx->free_containers.clear();
+        return ret;
+    abort:
+        return ret;
+    }
+
+    /* Adds the container and the ones under it to the free list */
+    static void free_container(Context* ctx, Container* ptr) {
+        auto& free_containers = ctx->free_containers;
+        SIZE idx = (SIZE)free_containers.size();
+        free_containers.push_back(ptr);
+        /* The free list is also the list of the containers whose children are not added yet */
+        for (;idx < free_containers.size();idx++) {
+            for (auto child : free_containers[idx]->children)
+                free_containers.push_back(child);
+        }
+    }
+
+    /**
+     * Sends the closed blocks of the unfinished DOC-level block
+     *
+     * Only the last child of a block is looked at by the next lines (see
+     * select_last_child_container), so the other children are finished. They are
+     * sent with their unfinished parents, which are entered with the boundaries
+     * known so far and left by send_previous_blocks(). Their containers are then
+     * reused by add_container()
+     */
+    static bool send_closed_blocks(Context* ctx) {
+        bool ret = true;
+        Container* root = ctx->containers->front();
+        /* Deepest block with closed children, its parents must be entered */
+        Container* last = nullptr;
+        for (Container* ptr = root;!ptr->children.empty() && !is_leaf_block(ptr->b_type);ptr = ptr->children.back()) {
+            if (ptr->children.size() > 1)
+                last = ptr;
+        }
+        if (last == nullptr)
+            return true;
+        if (ctx->pool != nullptr)
+            resolve_spans_concurrently(ctx, root, true);
+
+        for (Container* ptr = root;;ptr = ptr->children.back()) {
+            if (ptr != root && !ptr->entered) {
+                emit_enter_block(ctx, ptr->b_type, ptr->content_boundaries, &ptr->attributes, &ptr->detail);
+                ptr->entered = true;
+            }
+            for (SIZE i = 0;i + 1 < ptr->children.size();i++) {
+                if (ptr->children[i]->b_type != BLOCK_EMPTY)
+                    CHECK_AND_RET(enter_block(ctx, ptr->children[i]));
+            }
+            if (ptr == last)
+                break;
+        }
+        /* Must be sent before the containers are reused */
+        CHECK_AND_RET(flush_events(ctx));
+
+        for (Container* ptr = root;;ptr = ptr->children.back()) {
+            auto& children = ptr->children;
+            if (children.size() > 1) {
+                for (SIZE i = 0;i + 1 < children.size();i++)
+                    free_container(ctx, children[i]);
+                children.erase(children.begin(), children.end() - 1);
+            }
+            if (ptr == last)
+                break;
         }
         return ret;
     abort:
         return ret;
     }
 
-    static void add_container(Context* ctx, BLOCK_TYPE block_type, const Boundaries& bounds, SegmentInfo* seg, std::shared_ptr<BlockDetail> detail = nullptr) {
+    /**
+     * Records that the parsing could be restarted from off
+     *
+     * Returns true if the parsing can be interrupted, i.e. when re-parsing
+     * and off was already a restart point in the previous parse
+    */
+    static bool add_restart_point(Context* ctx, OFFSET off) {
+        if (ctx->result != nullptr) {
+            ctx->result->restart_offsets.push_back(off);
+            ctx->result->restart_lines.push_back(offset_to_line_number(ctx, off));
+        }
+        ctx->batches_since_restart = 0;
+        if (ctx->previous == nullptr || off < ctx->edit_new_end || off == ctx->start)
+            return false;
+        auto& points = ctx->previous->restart_offsets;
+        if (std::binary_search(points.begin(), points.end(), off - ctx->edit_delta)) {
+            if (ctx->result != nullptr) {
+                ctx->result->restart_offsets.pop_back();
+                ctx->result->restart_lines.pop_back();
+                ctx->result->reparsed_end = off;
+            }
+            ctx->interrupted = true;
+            return true;
+        }
+        return false;
+    }
+
+    static void add_container(Context* ctx, BLOCK_TYPE block_type, const Boundaries& bounds, SegmentInfo* seg, const BlockDetail& detail = BlockDetail()) {
         Container* parent = ctx->current_container;
         /* This means there is some already allocated memory
          * to be used */
-        bool is_free_memory = ctx->last_free_mem_it != ctx->containers.end();
+        bool is_free_memory = ctx->first_free_container < ctx->containers->size();
 
+        /* Either way, the container may have been used by a block already sent */
         Container* container;
-        if (is_free_memory) {
-            container = *ctx->last_free_mem_it;
+        if (!ctx->free_containers.empty()) {
+            container = ctx->free_containers.back();
+            ctx->free_containers.pop_back();
+        }
+        else if (is_free_memory) {
+            container = (*ctx->containers)[ctx->first_free_container++];
         }
         else {
-            container = new Container(); /* New containers will be deleted at the end of parsing in parse.cpp */
+            container = ctx->containers->add();
+            ctx->first_free_container++;
         }
+        container->reset();
 
         container->b_type = block_type;
         container->content_boundaries.push_back(bounds);
         container->detail = detail;
         container->parent = parent;
+        container->depth = parent->depth + 1;
         container->indent = seg->indent;
         container->flag = seg->flags;
-        container->attributes = seg->attributes;
+        if (seg->attributes != nullptr)
+            container->attributes = *seg->attributes;
         if (block_type == BLOCK_EMPTY) {
             container->closed = true;
         }
         if (block_type != BLOCK_HIDDEN) {
             parent->last_non_empty_child_line = seg->line_number;
         }
-        if (is_free_memory) {
-            ctx->last_free_mem_it++;
-        }
-        else {
-            ctx->containers.push_back(container);
-            ctx->last_free_mem_it = ctx->containers.end();
-        }
         ctx->current_container = container;
         parent->children.push_back(container);
+        /* The current container, which is the parent, is always in open_containers */
+        ctx->open_containers.resize(container->depth);
+        ctx->open_containers.push_back(container);
     }
 
     /* Pass a non-null ptr and non root ptr to this function */
@@ -691,7 +861,7 @@ namespace AB {
     bool make_list_item(Context* ctx, SegmentInfo* seg, OFFSET off) {
         Container* above_container = ctx->above_container;
 
-        bool is_ul = seg->acc.empty();
+        bool is_ul = seg->name.empty();
         char pre_marker = seg->li_pre_marker;
         char post_marker = seg->li_post_marker;
         Container* above_parent = (above_container != nullptr) ? above_container->parent : nullptr;
@@ -701,9 +871,9 @@ namespace AB {
         BlockOlDetail::OL_TYPE type;
         int alpha = -1; int roman = -1;
         if (!is_ul) {
-            alpha = alpha_to_decimal(seg->acc);
-            roman = roman_to_decimal(seg->acc);
-            if (verify_positiv_number(seg->acc)) {
+            alpha = alpha_to_decimal(seg->name);
+            roman = roman_to_decimal(seg->name);
+            if (verify_positiv_number(seg->name)) {
                 type = BlockOlDetail::OL_NUMERIC;
             }
             /* With this simple rule, we can decide between cases that are valid in both roman
@@ -729,27 +899,27 @@ namespace AB {
             make_new_list = true;
         }
         else if (is_above_ul) {
-            auto detail = std::static_pointer_cast<BlockUlDetail>(above_parent->detail);
+            auto& detail = std::get<BlockUlDetail>(above_parent->detail);
             /* Even there is an above list, if the marker don't match then a new list
              * is still created */
-            if (pre_marker != detail->marker)
+            if (pre_marker != detail.marker)
                 make_new_list = true;
         }
         else if (is_above_ol && !is_ul) {
-            auto detail = std::static_pointer_cast<BlockOlDetail>(above_parent->detail);
-            if (detail->pre_marker != pre_marker || detail->post_marker != post_marker)
+            auto& detail = std::get<BlockOlDetail>(above_parent->detail);
+            if (detail.pre_marker != pre_marker || detail.post_marker != post_marker)
                 make_new_list = true;
 
             /* By default, we choose the enumeration type of the one that is lowest in decimal
              * However, if we are already in a list that is either alpha or roman, then the
              * current list item must inherit the alpha or roman property */
             if (type != BlockOlDetail::OL_NUMERIC) {
-                if (detail->type == BlockOlDetail::OL_ALPHABETIC && roman > 0 && alpha > 0)
+                if (detail.type == BlockOlDetail::OL_ALPHABETIC && roman > 0 && alpha > 0)
                     type = BlockOlDetail::OL_ALPHABETIC;
-                else if (detail->type == BlockOlDetail::OL_ROMAN && roman > 0 && alpha > 0)
+                else if (detail.type == BlockOlDetail::OL_ROMAN && roman > 0 && alpha > 0)
                     type = BlockOlDetail::OL_ROMAN;
             }
-            if (type != detail->type)
+            if (type != detail.type)
                 make_new_list = true;
         }
         else if (is_above_ol && is_ul) {
@@ -775,17 +945,17 @@ namespace AB {
             }
         }
         if (make_new_list) {
-            if (seg->acc.empty()) {
-                auto detail = std::make_shared<BlockUlDetail>();
-                detail->marker = pre_marker;
+            if (is_ul) {
+                BlockUlDetail detail;
+                detail.marker = pre_marker;
                 add_container(ctx, BLOCK_UL, { seg->line_number, seg->b_bounds.pre, seg->b_bounds.pre, seg->end, seg->end }, seg, detail);
             }
             else {
-                auto detail = std::make_shared<BlockOlDetail>();
-                detail->pre_marker = pre_marker;
-                detail->post_marker = post_marker;
-                detail->type = type;
-                detail->lower_case = ISLOWER(seg->b_bounds.beg);
+                BlockOlDetail detail;
+                detail.pre_marker = pre_marker;
+                detail.post_marker = post_marker;
+                detail.type = type;
+                detail.lower_case = ISLOWER(seg->b_bounds.beg);
                 add_container(ctx, BLOCK_OL, { seg->line_number,seg->b_bounds.pre, seg->b_bounds.pre, seg->end, seg->end }, seg, detail);
             }
         }
@@ -795,9 +965,9 @@ namespace AB {
         }
 
         // We can now add our list item
-        auto detail = std::make_shared<BlockLiDetail>();
+        BlockLiDetail detail;
         if (!is_ul)
-            detail->number = seg->acc;
+            detail.number = seg->name;
         add_container(ctx, BLOCK_LI, { seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->end, seg->end }, seg, detail);
         if (seg->no_content_after) {
             add_container(ctx, BLOCK_EMPTY, {}, seg);
@@ -865,12 +1035,16 @@ namespace AB {
 
                 if (above_container->parent->b_type == BLOCK_DOC && !seg->blank_line) {
                     send_previous_blocks(ctx);
+                    /* Without indentation, the block above has no influence on how the
+                     * line is analysed, which is the same as starting from scratch */
+                    if (above_container->indent == 0 && add_restart_point(ctx, seg->start))
+                        return true;
                 }
             }
         }
 
         if (seg->blank_line) {
-            Container* parent = ctx->containers.back(); // By default, blank lines belong to ROOT
+            Container* parent = ctx->current_container; // By default, blank lines belong to the last inserted block
             /* Blank lines should always be commited to parent above container */
             if (above_container != nullptr) {
                 parent = select_parent(above_container);
@@ -908,8 +1082,7 @@ namespace AB {
             }
 
             if (IS_BLOCK_CONTINUED(BLOCK_H)) {
-                auto detail = std::static_pointer_cast<BlockHDetail>(above_container->detail);
-                if (detail->level == level) {
+                if (std::get<BlockHDetail>(above_container->detail).level == level) {
                     new_header = false;
                     above_container->content_boundaries.push_back({ seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->end, seg->end });
                 }
@@ -918,8 +1091,8 @@ namespace AB {
                 }
             }
             if (new_header) {
-                auto detail = std::make_shared<BlockHDetail>();
-                detail->level = level;
+                BlockHDetail detail;
+                detail.level = level;
                 add_container(ctx, BLOCK_H, { seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->end, seg->end }, seg, detail);
             }
         }
@@ -932,14 +1105,14 @@ namespace AB {
             }
         }
         else if (seg->flags & DEFINITION_OPENER) {
-            auto detail = std::make_shared<BlockDefDetail>();
-            detail->name = seg->acc;
-            if (seg->acc[0] == '^')
-                detail->definition_type = BlockDefDetail::DEF_FOOTNOTE;
-            else if (seg->acc[0] == 'c' && seg->acc.length() > 3 && seg->acc[1] == ':')
-                detail->definition_type = BlockDefDetail::DEF_CITATION;
+            BlockDefDetail detail;
+            detail.name = seg->name;
+            if (seg->name[0] == '^')
+                detail.definition_type = BlockDefDetail::DEF_FOOTNOTE;
+            else if (seg->name[0] == 'c' && seg->name.length() > 3 && seg->name[1] == ':')
+                detail.definition_type = BlockDefDetail::DEF_CITATION;
             else
-                detail->definition_type = BlockDefDetail::DEF_LINK;
+                detail.definition_type = BlockDefDetail::DEF_LINK;
             add_container(ctx, BLOCK_DEF, { seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->b_bounds.end, seg->b_bounds.post }, seg, detail);
         }
         else if (seg->flags & LIST_OPENER) {
@@ -947,8 +1120,8 @@ namespace AB {
             make_list_item(ctx, seg, *off);
         }
         else if (seg->flags & DIV_OPENER) {
-            auto detail = std::make_shared<BlockDivDetail>();
-            detail->name = seg->acc;
+            BlockDivDetail detail;
+            detail.name = seg->name;
             add_container(ctx, BLOCK_DIV, { seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->b_bounds.end, seg->b_bounds.post }, seg, detail);
             seg->flags = 0;
             add_container(ctx, BLOCK_EMPTY, { seg->line_number }, seg);
@@ -956,7 +1129,10 @@ namespace AB {
         else if (seg->flags & LATEX_OPENER) {
             if (IS_BLOCK_CONTINUED(BLOCK_LATEX)) {
                 ctx->current_container->content_boundaries.push_back({ seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->b_bounds.end, seg->b_bounds.post });
-                ctx->current_container->attributes = seg->attributes;
+                if (seg->attributes != nullptr)
+                    ctx->current_container->attributes = *seg->attributes;
+                else
+                    ctx->current_container->attributes.clear();
             }
             else {
                 add_container(ctx, BLOCK_LATEX, { seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->b_bounds.end, seg->b_bounds.post }, seg);
@@ -976,8 +1152,8 @@ namespace AB {
                 ctx->current_container->content_boundaries.push_back({ seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->b_bounds.end, seg->b_bounds.post });
             }
             else {
-                auto detail = std::make_shared<BlockCodeDetail>();
-                detail->lang = seg->acc;
+                BlockCodeDetail detail;
+                detail.lang = seg->name;
                 add_container(ctx, BLOCK_CODE, { seg->line_number, seg->b_bounds.pre, seg->b_bounds.beg, seg->b_bounds.end, seg->b_bounds.post }, seg, detail);
                 auto& r = ctx->current_container->repeated_markers;
                 r.marker = '`';
@@ -1002,30 +1178,46 @@ namespace AB {
         SegmentInfo current_seg;
 
         // Add root container
-        Container* doc_container = new Container();
+        ctx->containers->clear();
+        Container* doc_container = ctx->containers->add();
+        doc_container->reset();
         doc_container->b_type = BLOCK_DOC;
-        ctx->containers.push_back(doc_container);
-        ctx->current_container = ctx->containers.front();
+        ctx->current_container = doc_container;
+        ctx->open_containers.clear();
+        ctx->open_containers.push_back(doc_container);
         /* Enter directly into DOC */
-        CHECK_AND_RET(ctx->parser->enter_block(BLOCK_DOC, {}, {}, nullptr));
+        static const Attributes no_attributes;
+        static const BlockDetail no_detail;
+        if (!ctx->skip_doc_enter)
+            emit_enter_block(ctx, BLOCK_DOC, BoundariesView(), &no_attributes, &no_detail);
 
-        ctx->last_free_mem_it = ctx->containers.begin() + 1;
+        ctx->first_free_container = 1;
+        ctx->free_containers.clear();
 
         while (off < (int)ctx->end) {
             select_last_child_container(ctx);
             CHECK_AND_RET(analyse_segment(ctx, off, &off, &current_seg));
             CHECK_AND_RET(process_segment(ctx, &off, &current_seg));
+            if (ctx->interrupted || ctx->stopped)
+                break;
 
             // We arrived at a the end of a line
             if (off >= current_seg.end) {
-                ctx->above_container = ctx->containers.front();
+                ctx->above_container = ctx->containers->front();
                 ctx->current_container = ctx->above_container;
                 off++;
+                if (ctx->max_unsent_blocks > 0 && ctx->first_free_container - ctx->free_containers.size() > ctx->max_unsent_blocks)
+                    CHECK_AND_RET(send_closed_blocks(ctx));
             }
         }
 
+        /* The blocks which are still open may continue in the next chunk */
+        if (ctx->partial || (ctx->interrupted && ctx->keep_doc_open))
+            return ret;
+
         CHECK_AND_RET(send_previous_blocks(ctx));
-        CHECK_AND_RET(ctx->parser->leave_block(BLOCK_DOC));
+        emit_leave_block(ctx, BLOCK_DOC);
+        CHECK_AND_RET(flush_events(ctx));
 
         return ret;
     abort:
@@ -1,23 +1,64 @@
 #include "parse_commons.h"
 #include "internal.h"
 
+#include <algorithm>
+
 namespace AB {
+    /* Key or value read by parse_attributes(): a range of the text, or a copy of
+     * its chars once a char in the middle of it has been skipped */
+    struct AttributeAcc {
+        OFFSET beg = 0;
+        OFFSET end = 0;
+        bool copied = false;
+        std::string copy;
+
+        void push(Context* ctx, OFFSET off) {
+            if (copied) {
+                copy += CH(off);
+            }
+            else if (beg == end || off == end) {
+                beg = (beg == end) ? off : beg;
+                end = off + 1;
+            }
+            else {
+                copied = true;
+                copy.assign(ctx->text + beg, end - beg);
+                copy += CH(off);
+            }
+        }
+        void clear() {
+            beg = end = 0;
+            copied = false;
+            copy.clear();
+        }
+        std::string_view view(Context* ctx) const {
+            return (copied) ? std::string_view(copy) : std::string_view(ctx->text + beg, end - beg);
+        }
+    };
+
+    static inline void set_attribute(Context* ctx, Attributes& attributes, const AttributeAcc& key, const AttributeAcc* value) {
+        if (value == nullptr)
+            attributes.set(key.view(ctx), std::string_view(), key.copied);
+        else
+            attributes.set(key.view(ctx), value->view(ctx), key.copied, value->copied);
+    }
+
     Attributes parse_attributes(Context* ctx, OFFSET* off) {
         Attributes attributes;
         bool start_collection = false;
         bool is_key = true;
         bool is_complete = false;
-        std::string acc;
-        std::string prev_key;
+        AttributeAcc acc;
+        AttributeAcc prev_key;
         for (;(SIZE)*off < ctx->end && CH(*off) != '\n';(*off)++) {
             char ch = CH(*off);
             if (ch == '\\')
                 continue;
             if (ch == '}') {
                 if (is_key)
-                    attributes[acc] = "";
+                    set_attribute(ctx, attributes, acc, nullptr);
                 else
-                    attributes[prev_key] = acc;
+                    set_attribute(ctx, attributes, prev_key, &acc);
 
                 if (start_collection)
                     is_complete = true;
@@ -28,25 +69,25 @@ namespace AB {
                 start_collection = true;
             if (ch == ',') {
                 if (is_key)
-                    attributes[acc] = "";
+                    set_attribute(ctx, attributes, acc, nullptr);
                 else
-                    attributes[prev_key] = acc;
+                    set_attribute(ctx, attributes, prev_key, &acc);
                 is_key = true;
-                prev_key = "";
-                acc = "";
+                prev_key.clear();
+                acc.clear();
                 continue;
             }
             else if (is_assignement) {
                 is_key = false;
-                attributes[acc] = "";
+                set_attribute(ctx, attributes, acc, nullptr);
                 prev_key = acc;
-                acc = "";
+                acc.clear();
                 continue;
             }
             else if (ISWHITESPACE(*off) && is_key)
                 continue;
             else
-                acc += ch;
+                acc.push(ctx, *off);
         }
         if (!is_complete)
             attributes.clear();
@@ -55,49 +96,142 @@ namespace AB {
     }
 
     void skip_whitespace(Context* ctx, OFFSET* off) {
-        while ((SIZE)*off < ctx->end && CH(*off) != '\n') {
-            if (!ISWHITESPACE(*off))
-                break;
-            (*off)++;
-        }
+        if (*off >= (OFFSET)ctx->end)
+            return;
+        /* '\n' is not part of the whitespaces bitmap */
+        *off = find_next_unset(ctx->structural_index.whitespaces, ctx->structural_index.base, *off, (OFFSET)ctx->end);
     }
 
     int count_marks(Context* ctx, OFFSET* off, char mark) {
-        int counter = 0;
-        while (CH(*off) != '\n' && *off < (OFFSET)ctx->end) {
-            if (CH(*off) == mark)
-                counter++;
-            else
-                break;
-            (*off)++;
-        }
+        int counter = count_marks(ctx, *off, mark);
+        *off += counter;
         return counter;
     }
 
     int count_marks(Context* ctx, OFFSET off, char mark) {
+        /* Marks are always structural characters, so the run of marks
+         * can't go beyond the run of structural characters */
+        OFFSET run_end = find_next_unset(ctx->structural_index.structurals, ctx->structural_index.base, off, (OFFSET)ctx->end);
         int counter = 0;
-        while (CH(off) != '\n' && off < (OFFSET)ctx->end) {
-            if (CH(off) == mark)
-                counter++;
-            else
-                break;
-            (off)++;
+        while (off < run_end && CH(off) == mark) {
+            counter++;
+            off++;
         }
         return counter;
     }
 
-    bool advance_until(Context* ctx, OFFSET* off, std::string& acc, char ch) {
-        bool found_end_char = false;
+    bool advance_until(Context* ctx, OFFSET* off, char ch) {
         for (;(SIZE)*off < ctx->end && CH(*off) != '\n';(*off)++) {
-            if (CH(*off) == '\\')
-                continue;
-            acc += CH(*off);
-            if (CH(*off) == ch) {
-                found_end_char = true;
-                break;
+            if (CH(*off) == ch)
+                return true;
+        }
+        return false;
+    }
+
+    std::string_view view_without_escapes(Context* ctx, OFFSET beg, OFFSET end) {
+        if (memchr(ctx->text + beg, '\\', end - beg) == nullptr)
+            return std::string_view(ctx->text + beg, end - beg);
+        /* The string may have been used by a previous parse, its memory is reused */
+        std::string* copy = ctx->detail_strings.add();
+        copy->clear();
+        for (OFFSET i = beg;i < end;i++) {
+            if (CH(i) != '\\')
+                *copy += CH(i);
+        }
+        return *copy;
+    }
+
+    int offset_to_line_number(Context* ctx, OFFSET off) {
+        auto& begs = ctx->line_number_begs;
+        int line = ctx->last_line_number;
+        if (line < (int)begs.size() && begs[line] <= off) {
+            if (line + 1 == (int)begs.size() || off < begs[line + 1])
+                return ctx->first_line_number + line;
+            if (line + 2 == (int)begs.size() || off < begs[line + 2]) {
+                ctx->last_line_number = line + 1;
+                return ctx->first_line_number + line + 1;
+            }
+        }
+        line = (int)(std::upper_bound(begs.begin(), begs.end(), off) - begs.begin()) - 1;
+        ctx->last_line_number = line;
+        return ctx->first_line_number + line;
+    }
+
+    void emit_enter_block(Context* ctx, BLOCK_TYPE type, BoundariesView bounds, const Attributes* attributes, const BlockDetail* detail) {
+        Event event;
+        event.e_type = EVENT_ENTER_BLOCK;
+        event.type = type;
+        event.bounds = bounds;
+        event.attributes = attributes;
+        event.block_detail = detail;
+        ctx->events.push_back(event);
+    }
+
+    void emit_leave_block(Context* ctx, BLOCK_TYPE type) {
+        Event event;
+        event.e_type = EVENT_LEAVE_BLOCK;
+        event.type = type;
+        ctx->events.push_back(event);
+    }
+
+    void emit_enter_span(Context* ctx, SPAN_TYPE type, BoundariesView bounds, const Attributes& attributes, const SpanDetail& detail) {
+        /* The pointer is set by flush_events(), as the arena may still grow */
+        ctx->event_bounds.insert(ctx->event_bounds.end(), bounds.begin(), bounds.end());
+
+        auto attributes_copy = ctx->event_attributes.add();
+        *attributes_copy = attributes;
+
+        auto detail_copy = ctx->event_span_details.add();
+        *detail_copy = detail;
+
+        Event event;
+        event.e_type = EVENT_ENTER_SPAN;
+        event.type = type;
+        event.bounds = BoundariesView(nullptr, bounds.size());
+        event.attributes = attributes_copy;
+        event.span_detail = detail_copy;
+        ctx->events.push_back(event);
+    }
+
+    void emit_leave_span(Context* ctx, SPAN_TYPE type) {
+        Event event;
+        event.e_type = EVENT_LEAVE_SPAN;
+        event.type = type;
+        ctx->events.push_back(event);
+    }
+
+    void emit_text(Context* ctx, TEXT_TYPE type, SIZE first) {
+        Event event;
+        event.e_type = EVENT_TEXT;
+        event.type = type;
+        event.bounds = BoundariesView(nullptr, (SIZE)ctx->event_bounds.size() - first);
+        ctx->events.push_back(event);
+    }
+
+    bool flush_events(Context* ctx) {
+        bool ret = true;
+        if (!ctx->events.empty())
+            ctx->batches_since_restart++;
+        if (!ctx->events.empty() && ctx->skip_batches > 0)
+            ctx->skip_batches--;
+        else if (!ctx->events.empty() && !ctx->stopped) {
+            /* The boundaries of the span and text events follow each other in the arena */
+            const Boundaries* bounds_ptr = ctx->event_bounds.data();
+            for (auto& event : ctx->events) {
+                if (event.e_type == EVENT_ENTER_SPAN || event.e_type == EVENT_TEXT) {
+                    event.bounds.ptr = bounds_ptr;
+                    bounds_ptr += event.bounds.count;
+                }
             }
+            ret = ctx->batch_fct(ctx->events, ctx->user_data);
         }
-        return found_end_char;
+        if (!ret)
+            ctx->stopped = true;
+        ctx->events.clear();
+        ctx->event_bounds.clear();
+        ctx->event_attributes.clear();
+        ctx->event_span_details.clear();
+        return ret;
     }
 
     bool is_leaf_block(BLOCK_TYPE b_type) {
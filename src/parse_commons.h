@@ -28,9 +28,44 @@ namespace AB {
 
     /**
      * Advances the cursor until the character is found or end of line
-     * Accumulates the characters in acc
     */
-    bool advance_until(Context* ctx, OFFSET* off, std::string& acc, char ch);
+    bool advance_until(Context* ctx, OFFSET* off, char ch);
+
+    /**
+     * Returns the text between beg and end without its backslashes: a view on the
+     * text if there is none, otherwise on a copy kept until the end of the parsing
+     * (in ctx->detail_strings)
+    */
+    std::string_view view_without_escapes(Context* ctx, OFFSET beg, OFFSET end);
+
+    /**
+     * Returns the line number of the offset
+     *
+     * Lookups on the same line or the next one as the previous lookup are O(1),
+     * otherwise the line is found by binary search in line_number_begs
+    */
+    int offset_to_line_number(Context* ctx, OFFSET off);
+
+    /**
+     * Adds events to the current batch
+     *
+     * Block events refer to the data of the containers, which must stay untouched until
+     * the batch is flushed. The data of span events is copied
+    */
+    void emit_enter_block(Context* ctx, BLOCK_TYPE type, BoundariesView bounds, const Attributes* attributes, const BlockDetail* detail);
+    void emit_leave_block(Context* ctx, BLOCK_TYPE type);
+    void emit_enter_span(Context* ctx, SPAN_TYPE type, BoundariesView bounds, const Attributes& attributes, const SpanDetail& detail);
+    void emit_leave_span(Context* ctx, SPAN_TYPE type);
+    /* Adds a text event, whose boundaries are the ones pushed
+     * in ctx->event_bounds from index first */
+    void emit_text(Context* ctx, TEXT_TYPE type, SIZE first);
+
+    /**
+     * Sends the current batch of events to ctx->batch_fct
+     *
+     * Returns false if the user asked to stop
+    */
+    bool flush_events(Context* ctx);
 
     /* Returns true if the block type is a leaf (meaning it contains text)*/
     bool is_leaf_block(BLOCK_TYPE b_type);
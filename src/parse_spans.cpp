@@ -1,8 +1,8 @@
 #include "parse_spans.h"
 #include "parse_commons.h"
+#include "thread_pool.h"
 #include <iostream>
-#include <unordered_set>
-#include <list>
+#include <vector>
 
 #define MAX_VERB_OPENINGS 32
 
@@ -69,7 +69,7 @@ namespace AB {
     static const int SELECT_ALL_LINKTYPE = SELECT_REFS | SELECT_IMGS | SELECT_LINKS;
 
     /**
-     * @brief Mark stores the rules for span detection
+     * @brief MarkRule stores the rules for span detection
      *
      * s_type
      *     name (flag) of the span
@@ -86,78 +86,47 @@ namespace AB {
      * repeat
      *     if true, then the opening and closing chars can be repeated as many times
      *     as needed
-     * count
-     *     stores the number of repeat chars if the previous attribute is true
      * second_close
      *     sometimes, spans are defined by a second closing rule
      *     e.g. [abc](def)  -->  open = "[", close = "](", second_close =")"
-     *
-     * The other attributes are used for solving the spans
-     *
-     * solved:
-     *     when true, it means that the mark has been solved (i.e. opening and closing found)
-     * is_closing:
-     *     if true, then mark is used as a closing landmark in the mark_chain
-     * pre, beg, line_number:
-     *     starting bounds of the span
-     * true_bounds:
-     *     once the span is solved, we calculate the true boundaries and store them there
      */
-    struct Mark {
+    struct MarkRule {
         int s_type = 0;
-        std::string open;
-        std::string close;
+        const char* open = "";
+        const char* close = "";
         bool need_ws_or_punct = false;
         int dont_allow_inside = 0;
         bool repeat = false;
-        int count = 0;
-        std::string second_close;
+        const char* second_close = "";
         bool no_self_nested = false;
         bool jump_after_match = false;
-
-        /* Once solved, we store this information */
-        bool solved = false;
-        bool is_closing = false;
-        OFFSET pre = 0;
-        OFFSET beg = 0;
-        int line_number = 0;
-        std::vector<Boundaries> true_bounds;
-        Attributes attributes;
-        Mark* start_ptr = nullptr;
     };
 
-    static const std::unordered_set<char> opening_marks{
-        '!', '[', '*', '`', '_', '{', '$', 'h'
-    };
-
-    static const std::unordered_set<char> closing_marks{
-        ']', '=', '*', '+', '-', '_', '`', '$', '}'
-    };
-
-    static const Mark marks[] = {
+    static constexpr MarkRule marks[] = {
         /* The order at which declare here is of crucial importance
          * If `*` is checked before `{*`, then `*` will be closed
          * before `{*` and thus making it impossible in most cases
          * to detect `{*`
          * */
-        Mark{ S_EM, "{_", "_}"},
-        Mark{ S_EM_SIMPLE, "_", "_", true},
-        Mark{ S_STRONG, "{*", "*}"},
-        Mark{ S_STRONG_SIMPLE, "*", "*", true},
-        Mark{ S_VERBATIME, "`", "`", false, SELECT_ALL, true},
-        Mark{ S_HIGHLIGHT, "{=", "=}"},
-        Mark{ S_UNDERLINE, "{+", "+}"},
-        Mark{ S_DELETE, "{-", "-}"},
-        Mark{ S_INSERTED_REF, "![[", "]]", false, SELECT_ALL},
-        Mark{ S_REF, "[[", "]]", false, SELECT_ALL},
-        Mark{ S_IMG_TITLE, "![", "](", false, SELECT_ALL_LINKTYPE, false, 0, ")"},
-        Mark{ S_IMG_DEF, "![", "][", false, SELECT_ALL_LINKTYPE, false, 0, "]"},
-        Mark{ S_IMG, "![", "]", false, SELECT_ALL},
-        Mark{ S_LINK, "[", "](", false, SELECT_ALL_LINKTYPE, false, 0, ")", true},
-        Mark{ S_LINKDEF, "[", "][", false, SELECT_ALL_LINKTYPE, false, 0, "]", true},
-        Mark{ S_LATEX, "$$", "$$", false, SELECT_ALL, false, 0, "", false, true},
-        Mark{ S_ATTRIBUTE, "{{", "}}", false, SELECT_ALL}
-        /* Autolinks handled by lookahead_autolink*/
+        MarkRule{ S_EM, "{_", "_}"},
+        MarkRule{ S_EM_SIMPLE, "_", "_", true},
+        MarkRule{ S_STRONG, "{*", "*}"},
+        MarkRule{ S_STRONG_SIMPLE, "*", "*", true},
+        MarkRule{ S_VERBATIME, "`", "`", false, SELECT_ALL, true},
+        MarkRule{ S_HIGHLIGHT, "{=", "=}"},
+        MarkRule{ S_UNDERLINE, "{+", "+}"},
+        MarkRule{ S_DELETE, "{-", "-}"},
+        MarkRule{ S_INSERTED_REF, "![[", "]]", false, SELECT_ALL},
+        MarkRule{ S_REF, "[[", "]]", false, SELECT_ALL},
+        MarkRule{ S_IMG_TITLE, "![", "](", false, SELECT_ALL_LINKTYPE, false, ")"},
+        MarkRule{ S_IMG_DEF, "![", "][", false, SELECT_ALL_LINKTYPE, false, "]"},
+        MarkRule{ S_IMG, "![", "]", false, SELECT_ALL},
+        MarkRule{ S_LINK, "[", "](", false, SELECT_ALL_LINKTYPE, false, ")", true},
+        MarkRule{ S_LINKDEF, "[", "][", false, SELECT_ALL_LINKTYPE, false, "]", true},
+        MarkRule{ S_LATEX, "$$", "$$", false, SELECT_ALL, false, "", false, true},
+        MarkRule{ S_ATTRIBUTE, "{{", "}}", false, SELECT_ALL},
+        /* Only found by lookahead_autolink */
+        MarkRule{ S_AUTOLINK, "http://", " ", false, SELECT_ALL}
     };
 #define M_EM 0
 #define M_EM_SIMPLE 1
@@ -176,43 +145,225 @@ namespace AB {
 #define M_LINKDEF 14
 #define M_LATEX 15
 #define M_ATTRIBUTE 16
+#define M_AUTOLINK 17
 
-    typedef std::list<Mark> MarkChain;
+    static constexpr int NUM_RULES = sizeof(marks) / sizeof(marks[0]);
 
-    inline bool check_match(Context* ctx, const std::string& str, int& i, OFFSET off, OFFSET end) {
-        int count = 0;
-        for (;str[i] != 0 && off + i < end;i++) {
-            if (str[i] != CH(off + i)) {
-                return false;
+    /* Number of span flags, S_ATTRIBUTE being the highest one */
+    static const int NUM_FLAGS = 18;
+    static_assert(S_ATTRIBUTE == 1 << (NUM_FLAGS - 1), "NUM_FLAGS must cover all the span flags");
+
+    /**
+     * Number of unsolved marks of each span flag, indexed by the position of
+     * the bit of the flag. positive has the bits of the flags whose count is
+     * positive, as the counts may become negative
+     */
+    struct FlagCounts {
+        int counts[NUM_FLAGS] = {};
+        int positive = 0;
+
+        void add(int flag) {
+            int idx = count_trailing_zeros(flag);
+            if (++counts[idx] > 0)
+                positive |= flag;
+        }
+        /* No testing of bounds */
+        void remove(int flag) {
+            int idx = count_trailing_zeros(flag);
+            if (--counts[idx] <= 0)
+                positive &= ~flag;
+        }
+        bool is_positive(int flag) const {
+            return positive & flag;
+        }
+    };
+
+    /**
+     * Rules to check when the main loop meets a character: first the rules
+     * closing with it, then if none matched the rules opening with it, in the
+     * order of marks[]. Autolinks are checked separately
+     */
+    struct CharRules {
+        unsigned char close[8] = {};
+        unsigned char open[8] = {};
+        int num_close = 0;
+        int num_open = 0;
+        bool autolink = false;
+    };
+
+    struct DispatchTable {
+        CharRules chars[256];
+    };
+
+    static constexpr DispatchTable make_dispatch_table() {
+        DispatchTable table{};
+        for (int rule = 0;rule < NUM_RULES;rule++) {
+            CharRules& opening = table.chars[(unsigned char)marks[rule].open[0]];
+            if (rule == M_AUTOLINK) {
+                opening.autolink = true;
+                continue;
             }
-            count++;
+            opening.open[opening.num_open++] = (unsigned char)rule;
+            CharRules& closing = table.chars[(unsigned char)marks[rule].close[0]];
+            closing.close[closing.num_close++] = (unsigned char)rule;
         }
-        if (count < str.length()) {
-            return false;
+        return table;
+    }
+
+    static constexpr DispatchTable dispatch_table = make_dispatch_table();
+
+    /* The main loop skips the characters which are not in the span_chars of the structural index */
+    static constexpr bool span_chars_cover_rules() {
+        for (int ch = 0;ch < 256;ch++) {
+            const CharRules& rules = dispatch_table.chars[ch];
+            if (rules.num_close == 0 && rules.num_open == 0)
+                continue;
+            bool found = false;
+            for (const char* span_ch = SPAN_CHARS;*span_ch;span_ch++)
+                found = found || (unsigned char)*span_ch == ch;
+            if (!found)
+                return false;
         }
-        return true;
+        return dispatch_table.chars[(unsigned char)'h'].autolink;
     }
+    static_assert(span_chars_cover_rules(), "SPAN_CHARS must contain the delimiters of marks[]");
 
-    void add_to_flag_count(std::unordered_map<int, int>& flag_count, int flag) {
-        if (flag_count.find(flag) != flag_count.end()) {
-            flag_count[flag]++;
+    /**
+     * @brief A mark found in the text, following the rule marks[rule]
+     *
+     * solved:
+     *     when true, it means that the mark has been solved (i.e. opening and closing found)
+     * is_closing:
+     *     if true, then mark is used as a closing landmark in the mark_chain
+     * erased:
+     *     the mark has been removed from the mark_chain
+     * count:
+     *     number of repeated chars, for the rules which repeat
+     * pre, beg, line_number:
+     *     starting bounds of the span
+     * bound:
+     *     index of the line of pre in the content boundaries of the block
+     * start:
+     *     for a closing mark, index of the opening mark in the mark_chain
+     * inner:
+     *     for a closing mark, flags of the solved spans inside (may contain
+     *     flags of spans which have been erased since)
+     * prev:
+     *     index of a previous mark, following prev until a mark which is not
+     *     erased gives the previous mark in the mark_chain
+     * first_bound, num_bounds:
+     *     once the span is solved, we calculate the true boundaries and store them
+     *     in the bounds of the mark_chain
+     * attributes:
+     *     index in the attributes of the mark_chain, -1 if none
+     */
+    struct Mark {
+        int s_type;
+        int rule;
+        int count;
+        bool solved;
+        bool is_closing;
+        bool erased;
+        OFFSET pre;
+        OFFSET beg;
+        int line_number;
+        int bound;
+        int start;
+        int inner;
+        int prev;
+        SIZE first_bound;
+        SIZE num_bounds;
+        int attributes;
+    };
+
+    /* Result of the last search of a character from an offset, see find_char() */
+    struct CharSearch {
+        OFFSET from = -1;
+        OFFSET end = -1;
+        OFFSET found = -1;
+    };
+
+    /**
+     * Marks of a leaf block, in the order of the text
+     *
+     * Removed marks are only flagged as erased, so that marks can refer to each
+     * other by index. The vectors keep their memory from one leaf block to another
+     *
+     * The unsolved openings are also stacked by rule (and count for the rules which
+     * repeat), so that closing a span never looks at the marks before its opening
+     */
+    struct MarkChain {
+        std::vector<Mark> marks;
+        std::vector<Boundaries> bounds;
+        std::vector<Attributes> attributes;
+        std::vector<int> openings[NUM_RULES + MAX_VERB_OPENINGS + 1];
+        /* Searches of the second_close of each rule */
+        CharSearch second_close_searches[NUM_RULES];
+
+        void clear() {
+            marks.clear();
+            bounds.clear();
+            attributes.clear();
+            for (auto& stack : openings)
+                stack.clear();
+            for (auto& search : second_close_searches)
+                search = CharSearch{};
         }
-        else {
-            flag_count[flag] = 1;
+        void push(int rule, int count, OFFSET pre, OFFSET beg, int line_number, int bound) {
+            int prev = (int)marks.size() - 1;
+            marks.push_back(Mark{ AB::marks[rule].s_type, rule, count, false, false, false, pre, beg, line_number, bound, -1, 0, prev, 0, 0, -1 });
         }
-    }
-    /* No testing of bounds */
-    void remove_from_flag_count(std::unordered_map<int, int>& flag_count, int flag) {
-        flag_count[flag]--;
+        std::vector<int>& openings_of(int rule, int count) {
+            return openings[AB::marks[rule].repeat ? NUM_RULES + count : rule];
+        }
+        /* Index of the mark before marks[idx] which is not erased, -1 if none */
+        int prev_mark(int idx) {
+            int prev = marks[idx].prev;
+            while (prev >= 0 && marks[prev].erased)
+                prev = marks[prev].prev;
+            marks[idx].prev = prev;
+            return prev;
+        }
+        BoundariesView true_bounds(const Mark& mark) const {
+            return BoundariesView(bounds.data() + mark.first_bound, mark.num_bounds);
+        }
+        Boundaries& last_bound(const Mark& mark) {
+            return bounds[mark.first_bound + mark.num_bounds - 1];
+        }
+    };
+
+    static const Attributes empty_attributes;
+
+    /* Returns true if str is at off, i is then the length of str */
+    inline bool check_match(Context* ctx, const char* str, int& i, OFFSET off, OFFSET end) {
+        for (;str[i] != 0 && off + i < end;i++) {
+            if (str[i] != CH(off + i)) {
+                return false;
+            }
+        }
+        /* The text may end before str */
+        return str[i] == 0;
     }
 
-    bool is_count_positive(std::unordered_map<int, int>& flag_count, int flag) {
-        if (flag_count.find(flag) != flag_count.end() && flag_count[flag] > 0)
-            return true;
-        return false;
+    /**
+     * Returns the first offset of ch in [from, end), or end if there is none
+     *
+     * If from is between the start of the previous search and its result, the
+     * result is the same, so successive searches from increasing offsets only
+     * go through the text once
+     */
+    static OFFSET find_char(Context* ctx, CharSearch& search, char ch, OFFSET from, OFFSET end) {
+        if (search.end != end || from < search.from || from > search.found) {
+            const char* found = static_cast<const char*>(memchr(ctx->text + from, ch, end - from));
+            search.from = from;
+            search.end = end;
+            search.found = (found == nullptr) ? end : (OFFSET)(found - ctx->text);
+        }
+        return search.found;
     }
 
-    inline bool close_mark(Context* ctx, MarkChain& mark_chain, const Mark& mark, OFFSET* off, OFFSET end, const std::vector<AB::Boundaries>& content_bounds, std::unordered_map<int, int>& flag_count) {
+    inline bool close_mark(Context* ctx, MarkChain& mark_chain, int rule, OFFSET* off, OFFSET end, int line_number, int bound_idx, const std::vector<AB::Boundaries>& content_bounds, FlagCounts& flag_count) {
+        const MarkRule& mark = marks[rule];
         bool found_match = true;
         OFFSET i = 0;
         OFFSET jump_to = *off;
@@ -235,20 +386,16 @@ namespace AB {
         else {
             found_match = check_match(ctx, mark.close, i, *off, end);
             jump_to = jump_to + i;
-            if (!mark.second_close.empty() && found_match) {
+            if (mark.second_close[0] != 0 && found_match) {
                 found_match = false;
-                OFFSET tmp_off = *off + 1;
                 /* Look ahead */
-                while (tmp_off < end) {
-                    if (CH(tmp_off) == mark.second_close[0]) {
-                        OFFSET j = 0;
-                        found_match = check_match(ctx, mark.second_close, j, tmp_off, end);
-                        if (found_match) {
-                            jump_to = tmp_off + j;
-                        }
-                        break;
+                OFFSET tmp_off = find_char(ctx, mark_chain.second_close_searches[rule], mark.second_close[0], *off + 1, end);
+                if (tmp_off < end) {
+                    OFFSET j = 0;
+                    found_match = check_match(ctx, mark.second_close, j, tmp_off, end);
+                    if (found_match) {
+                        jump_to = tmp_off + j;
                     }
-                    tmp_off++;
                 }
             }
         }
@@ -257,73 +404,79 @@ namespace AB {
             found_match = false;
 
         if (found_match) {
-            auto it = mark_chain.rbegin();
-            auto current = mark_chain.rbegin();
-            std::vector<std::list<Mark>::iterator> to_erase;
-
-            while (it != mark_chain.rend()) {
-                if (it->solved) {
-                    if (!(it->s_type & mark.dont_allow_inside)) {
-                        it++;
-                        continue;
-                    }
-                }
-                else if (it->s_type == mark.s_type && it->count == mark_count) {
-                    break;
+            auto& chain = mark_chain.marks;
+            /* The opening is the last unsolved mark of the same rule and count */
+            auto& openings = mark_chain.openings_of(rule, mark_count);
+            while (!openings.empty() && (chain[openings.back()].erased || chain[openings.back()].solved))
+                openings.pop_back();
+            if (openings.empty())
+                return false;
+            int idx = openings.back();
+            openings.pop_back();
+
+            /* The marks in between are erased, except the solved spans allowed inside
+             * Spans which contain nothing to erase are skipped as a whole */
+            int inner = 0;
+            for (int j = (int)chain.size() - 1;j > idx;j = mark_chain.prev_mark(j)) {
+                Mark& m = chain[j];
+                if (!m.solved || (m.s_type & mark.dont_allow_inside)) {
+                    flag_count.remove(m.s_type);
+                    m.erased = true;
                 }
-                to_erase.push_back(std::next(it).base());
-                it++;
-            }
-            if (it != mark_chain.rend() && !mark_chain.empty()) {
-                it->solved = true;
-
-                Mark tmp_mark(*it);
-                /* Need to calculate the true boundaries of the span
-                 * A span can be on multiple lines, this is why we need
-                 * to use content_boundaries */
-                OFFSET b_end = *off;
-                OFFSET b_post = jump_to;
-                int line_number = ctx->offset_to_line_number[b_end];
-                if (line_number > tmp_mark.line_number) {
-                    auto bound_it = content_bounds.begin();
-                    while (bound_it != content_bounds.end()) {
-                        if (bound_it->line_number == it->line_number)
-                            break;
-                        bound_it++;
-                    }
-                    /* Starting boundary */
-                    it->true_bounds.push_back(Boundaries{ it->line_number, tmp_mark.pre, tmp_mark.beg, bound_it->end, bound_it->end });
-                    bound_it++;
-                    /* Inbetween boundaries */
-                    while (bound_it != content_bounds.end()) {
-                        if (bound_it->line_number == line_number)
-                            break;
-                        it->true_bounds.push_back(Boundaries{ bound_it->line_number, bound_it->beg, bound_it->beg, bound_it->end, bound_it->end });
-                        bound_it++;
-                    }
-                    /* Last boundary */
-                    it->true_bounds.push_back(Boundaries{ line_number, bound_it->beg, bound_it->beg, b_end, b_post });
+                else if (m.is_closing && !(m.inner & mark.dont_allow_inside)) {
+                    inner |= m.s_type | m.inner;
+                    j = m.start;
                 }
                 else {
-                    it->true_bounds.push_back(Boundaries{ line_number, tmp_mark.pre, tmp_mark.beg, b_end, b_post });
+                    inner |= m.s_type;
+                    m.inner &= ~mark.dont_allow_inside;
                 }
-                tmp_mark.solved = true;
-                tmp_mark.is_closing = true;
-                tmp_mark.start_ptr = &(*it);
-                for (auto& m : to_erase) {
-                    remove_from_flag_count(flag_count, m->s_type);
-                    mark_chain.erase(m);
+            }
+
+            Mark& opening = chain[idx];
+            opening.solved = true;
+            opening.first_bound = (SIZE)mark_chain.bounds.size();
+
+            auto& true_bounds = mark_chain.bounds;
+            /* Need to calculate the true boundaries of the span
+             * A span can be on multiple lines, this is why we need
+             * to use content_boundaries */
+            OFFSET b_end = *off;
+            OFFSET b_post = jump_to;
+            if (line_number > opening.line_number) {
+                const Boundaries& first = content_bounds[opening.bound];
+                /* Starting boundary */
+                true_bounds.push_back(Boundaries{ opening.line_number, opening.pre, opening.beg, first.end, first.end });
+                /* Inbetween boundaries */
+                for (int b = opening.bound + 1;b < bound_idx;b++) {
+                    const Boundaries& bound = content_bounds[b];
+                    true_bounds.push_back(Boundaries{ bound.line_number, bound.beg, bound.beg, bound.end, bound.end });
                 }
-                mark_chain.push_back(tmp_mark);
-                *off = jump_to;
-                return true;
+                /* Last boundary */
+                const Boundaries& last = content_bounds[bound_idx];
+                true_bounds.push_back(Boundaries{ line_number, last.beg, last.beg, b_end, b_post });
             }
+            else {
+                true_bounds.push_back(Boundaries{ line_number, opening.pre, opening.beg, b_end, b_post });
+            }
+            opening.num_bounds = (SIZE)true_bounds.size() - opening.first_bound;
+
+            Mark closing = opening;
+            closing.is_closing = true;
+            closing.start = idx;
+            closing.inner = inner;
+            closing.prev = (int)chain.size() - 1;
+            closing.num_bounds = 0;
+            chain.push_back(closing);
+            *off = jump_to;
+            return true;
         }
 
         return false;
     }
 
-    inline int open_mark(Context* ctx, MarkChain& mark_chain, const Mark& mark, OFFSET off, OFFSET end, bool ws_or_punct_before, std::unordered_map<int, int>& flag_count) {
+    inline int open_mark(Context* ctx, MarkChain& mark_chain, int rule, OFFSET off, OFFSET end, int line_number, int bound_idx, bool ws_or_punct_before, FlagCounts& flag_count) {
+        const MarkRule& mark = marks[rule];
         bool found_match = true;
         OFFSET i = 0;
         int mark_count = 0;
@@ -346,27 +499,25 @@ namespace AB {
             found_match = false;
 
         if (found_match) {
-            Mark tmp_mark(mark);
-            tmp_mark.line_number = ctx->offset_to_line_number[off];
-            tmp_mark.pre = off;
+            OFFSET beg;
             if (mark.repeat) {
-                tmp_mark.count = mark_count;
-                tmp_mark.beg = off + mark_count;
+                beg = off + mark_count;
             }
             else {
-                tmp_mark.beg = off + (OFFSET)mark.open.length();
+                beg = off + (OFFSET)strlen(mark.open);
             }
-            mark_chain.push_back(tmp_mark);
-            add_to_flag_count(flag_count, mark.s_type);
+            mark_chain.openings_of(rule, mark_count).push_back((int)mark_chain.marks.size());
+            mark_chain.push(rule, mark_count, off, beg, line_number, bound_idx);
+            flag_count.add(mark.s_type);
             if (mark.jump_after_match)
-                return mark.open.length();
+                return (int)strlen(mark.open);
             else
                 return mark_count;
         }
         return 0;
     }
 
-    bool lookahead_autolink(Context* ctx, MarkChain& mark_chain, OFFSET* off, OFFSET end) {
+    bool lookahead_autolink(Context* ctx, MarkChain& mark_chain, OFFSET* off, OFFSET end, int line_number) {
         /* Basic efficient sanity check, look for http:// or https:// */
         if (*off + 7 >= end)
             return false;
@@ -389,22 +540,27 @@ namespace AB {
             }
             (*off)++;
         }
-        Mark autolink{ S_AUTOLINK, "http://", " ", false, SELECT_ALL };
+        mark_chain.push(M_AUTOLINK, 0, 0, 0, 0, 0);
+        Mark& autolink = mark_chain.marks.back();
         autolink.solved = true;
-        autolink.true_bounds.push_back(Boundaries{ ctx->offset_to_line_number[start], start, start, *off, *off });
-        mark_chain.push_back(autolink);
-        auto ptr = &(mark_chain.back());
-        autolink.is_closing = true;
-        autolink.start_ptr = ptr;
-        mark_chain.push_back(autolink);
+        autolink.first_bound = (SIZE)mark_chain.bounds.size();
+        autolink.num_bounds = 1;
+        mark_chain.bounds.push_back(Boundaries{ line_number, start, start, *off, *off });
+        Mark closing = autolink;
+        closing.is_closing = true;
+        closing.start = (int)mark_chain.marks.size() - 1;
+        closing.prev = closing.start;
+        closing.num_bounds = 0;
+        mark_chain.marks.push_back(closing);
         return true;
     }
 
     bool create_text(Context* ctx, std::vector<Boundaries>::iterator& b_it, std::vector<Boundaries>::iterator& b_end_it, TEXT_TYPE type, OFFSET start, OFFSET end) {
-        bool ret = true;
         if (start == end || end > ctx->end)
             return true;
-        std::vector<Boundaries> bounds;
+        /* The boundaries are directly written in the arena of the events */
+        std::vector<Boundaries>& bounds = ctx->event_bounds;
+        SIZE first = (SIZE)bounds.size();
 
         /* Edge case if the cursor just stopped on a new line */
         if (start == b_it->post) {
@@ -412,7 +568,7 @@ namespace AB {
             start = b_it->beg;
         }
 
-        int last_line = ctx->offset_to_line_number[end];
+        int last_line = offset_to_line_number(ctx, end);
         int diff = last_line - b_it->line_number;
         if (diff > 0) {
             bounds.push_back({ b_it->line_number, start, start, b_it->end, b_it->end });
@@ -433,37 +589,51 @@ namespace AB {
             bounds.push_back({ b_it->line_number, start, start, end, end });
         }
 
-        CHECK_AND_RET(ctx->parser->text(type, bounds));
+        emit_text(ctx, type, first);
 
         return true;
-    abort:
-        return ret;
     }
 
     inline bool main_loop(Context* ctx, Container* ptr, MarkChain& mark_chain) {
         bool ret = true;
-        std::unordered_map<int, int> flag_count;
+        FlagCounts flag_count;
+        const StructuralIndex& index = ctx->structural_index;
 
-#define OPEN_MARK(num) {int mark_count = open_mark(ctx, mark_chain, marks[(num)], off, bound.end, prev_is_punctuation || prev_is_whitespace, flag_count); \
+#define OPEN_MARK(num) {int mark_count = open_mark(ctx, mark_chain, (num), off, bound.end, bound.line_number, bound_idx, prev_is_punctuation || prev_is_whitespace, flag_count); \
                         if (mark_count > advance) advance = mark_count; }
 
-#define CLOSE_MARK(num) if (!success && is_count_positive(flag_count, marks[(num)].s_type)) { \
-                    success = close_mark(ctx, mark_chain, marks[(num)], &off, bound.end, ptr->content_boundaries, flag_count); \
-                    if (success) { remove_from_flag_count(flag_count, marks[(num)].s_type); advance = 0; } \
+#define CLOSE_MARK(num) if (!success && flag_count.is_positive(marks[(num)].s_type)) { \
+                    success = close_mark(ctx, mark_chain, (num), &off, bound.end, bound.line_number, bound_idx, ptr->content_boundaries, flag_count); \
+                    if (success) { flag_count.remove(marks[(num)].s_type); advance = 0; } \
                 }
 
-        for (auto& bound : ptr->content_boundaries) {
+        for (int bound_idx = 0;bound_idx < (int)ptr->content_boundaries.size();bound_idx++) {
+            const Boundaries& bound = ptr->content_boundaries[bound_idx];
             bool prev_is_whitespace = true;
             bool prev_is_punctuation = false;
             /* Kind of a hack to avoid making ![[]] become !<ref />*/
             bool prev_is_exclamation_or_bracket = false;
             for (OFFSET off = bound.beg;off < bound.end;) {
+                /* Jump to the next character which may start or end a span, the
+                 * characters in between only change the state before a mark */
+                OFFSET next = find_next_set(index.span_chars, index.base, off, bound.end);
+                if (next > off) {
+                    if (!prev_is_whitespace && find_next_set(index.whitespaces, index.base, off, next) < next)
+                        prev_is_whitespace = true;
+                    for (;!prev_is_punctuation && off < next;off++) {
+                        if (ISPUNCT(off))
+                            prev_is_punctuation = true;
+                    }
+                    off = next;
+                    if (off >= bound.end)
+                        break;
+                }
                 bool success = false;
                 int advance = 1;
 
                 if (CH(off) == '\\') {
                     /* Edge case for `\` */
-                    if (!mark_chain.empty() && mark_chain.back().s_type & S_VERBATIME && CH(off + 1) == '`')
+                    if (!mark_chain.marks.empty() && mark_chain.marks.back().s_type & S_VERBATIME && CH(off + 1) == '`')
                         off++;
 
                     else
@@ -473,78 +643,20 @@ namespace AB {
 
                 else if (ISWHITESPACE(off))
                     prev_is_whitespace = true;
-                /* Opening marks, num based on table marks */
-                else if (CH(off) == '{') {
-                    OPEN_MARK(M_EM);
-                    OPEN_MARK(M_STRONG);
-                    OPEN_MARK(M_HIGHLIGHT);
-                    OPEN_MARK(M_UNDERLINE);
-                    OPEN_MARK(M_DELETE);
-                    OPEN_MARK(M_ATTRIBUTE);
-                }
-                else if (CH(off) == '*') {
-                    CLOSE_MARK(M_STRONG);
-                    CLOSE_MARK(M_STRONG_SIMPLE);
-                    if (!success) {
-                        OPEN_MARK(M_STRONG_SIMPLE);
-                    }
-                }
-                else if (CH(off) == '_') {
-                    CLOSE_MARK(M_EM);
-                    CLOSE_MARK(M_EM_SIMPLE);
-                    if (!success) {
-                        OPEN_MARK(M_EM_SIMPLE);
-                    }
-                }
-                else if (CH(off) == '`') {
-                    CLOSE_MARK(M_VERBATIME);
-                    if (!success) {
-                        OPEN_MARK(M_VERBATIME);
+                else {
+                    /* Marks, num based on table marks */
+                    const CharRules& rules = dispatch_table.chars[(unsigned char)CH(off)];
+                    if (rules.autolink && lookahead_autolink(ctx, mark_chain, &off, bound.end, bound.line_number))
+                        continue;
+                    for (int i = 0;i < rules.num_close;i++) {
+                        CLOSE_MARK(rules.close[i]);
                     }
-                }
-                else if (CH(off) == '!') {
-                    OPEN_MARK(M_INSERTED_REF);
-                    OPEN_MARK(M_IMG_TITLE);
-                    OPEN_MARK(M_IMG_DEF);
-                    OPEN_MARK(M_IMG);
-                }
-                else if (CH(off) == '[') {
-                    OPEN_MARK(M_REF);
-                    OPEN_MARK(M_LINK);
-                    OPEN_MARK(M_LINKDEF);
-                }
-                else if (CH(off) == '$') {
-                    CLOSE_MARK(M_LATEX);
                     if (!success) {
-                        OPEN_MARK(M_LATEX);
+                        for (int i = 0;i < rules.num_open;i++) {
+                            OPEN_MARK(rules.open[i]);
+                        }
                     }
                 }
-                else if (CH(off) == 'h') {
-                    bool success = lookahead_autolink(ctx, mark_chain, &off, bound.end);
-                    if (success)
-                        continue;
-                }
-                else if (CH(off) == '=') {
-                    CLOSE_MARK(M_HIGHLIGHT);
-                }
-                else if (CH(off) == '+') {
-                    CLOSE_MARK(M_UNDERLINE);
-                }
-                else if (CH(off) == '-') {
-                    CLOSE_MARK(M_DELETE);
-                }
-                else if (CH(off) == ']') {
-                    CLOSE_MARK(M_INSERTED_REF);
-                    CLOSE_MARK(M_REF);
-                    CLOSE_MARK(M_IMG_TITLE);
-                    CLOSE_MARK(M_IMG_DEF);
-                    CLOSE_MARK(M_IMG);
-                    CLOSE_MARK(M_LINK);
-                    CLOSE_MARK(M_LINKDEF);
-                }
-                else if (CH(off) == '}') {
-                    CLOSE_MARK(M_ATTRIBUTE);
-                }
 
                 if (ISPUNCT(off))
                     prev_is_punctuation = true;
@@ -560,24 +672,30 @@ namespace AB {
         bool ret = true;
 
         /* Cleanup of unmatched spans and attribute creation */
-        std::vector<std::list<Mark>::iterator> to_erase;
-        for (auto it = mark_chain.begin();it != mark_chain.end();it++) {
-            if (!it->solved) {
-                to_erase.push_back(it);
+        auto& chain = mark_chain.marks;
+        /* Previous mark of the chain, even if erased by the cleanup */
+        int prev = -1;
+        for (int i = 0;i < (int)chain.size();i++) {
+            if (chain[i].erased)
+                continue;
+            Mark& mark = chain[i];
+            if (!mark.solved) {
+                mark.erased = true;
             }
-            else if (it->s_type == S_ATTRIBUTE) {
-                auto next = std::next(it);
-                if (it != mark_chain.begin() && std::prev(it)->solved) {
-                    auto prev = std::prev(it);
+            else if (mark.s_type == S_ATTRIBUTE) {
+                int next = i + 1;
+                while (next < (int)chain.size() && chain[next].erased)
+                    next++;
+                /* Attributes belong to the span closed just before them */
+                if (prev >= 0 && chain[prev].solved && chain[prev].is_closing) {
+                    Mark& span = chain[chain[prev].start];
                     /* Need to test if btw prev and attribute there is only whitespace */
-                    auto prev_bound = prev->start_ptr->true_bounds.back();
+                    auto prev_bound = mark_chain.last_bound(span);
                     bool valid_attribute = true;
-                    if (!prev->solved)
-                        valid_attribute = false;
-                    if (valid_attribute && prev_bound.line_number != it->line_number)
+                    if (prev_bound.line_number != mark.line_number)
                         valid_attribute = false;
                     if (valid_attribute)
-                        for (OFFSET off = prev_bound.post;off < it->pre;off++) {
+                        for (OFFSET off = prev_bound.post;off < mark.pre;off++) {
                             if (!ISWHITESPACE(off)) {
                                 valid_attribute = false;
                                 break;
@@ -585,22 +703,32 @@ namespace AB {
                         }
 
                     if (valid_attribute) {
-                        OFFSET off = it->beg;
-                        prev->start_ptr->attributes = parse_attributes(ctx, &off);
-                        prev->start_ptr->true_bounds.back().post = it->true_bounds.back().post;
+                        OFFSET off = mark.beg;
+                        if (span.attributes < 0) {
+                            span.attributes = (int)mark_chain.attributes.size();
+                            mark_chain.attributes.emplace_back();
+                        }
+                        mark_chain.attributes[span.attributes] = parse_attributes(ctx, &off);
+                        mark_chain.last_bound(span).post = mark_chain.last_bound(mark).post;
                     }
                 }
-                to_erase.push_back(it);
-                to_erase.push_back(next);
-                it++;
+                mark.erased = true;
+                if (next < (int)chain.size())
+                    chain[next].erased = true;
+                prev = next;
+                i = next;
+                continue;
             }
-        }
-        for (auto it : to_erase) {
-            mark_chain.erase(it);
+            prev = i;
         }
         return ret;
     }
 
+    /* Empty if end is before beg */
+    static inline std::string_view text_view(Context* ctx, OFFSET beg, OFFSET end) {
+        return (end > beg) ? std::string_view(ctx->text + beg, end - beg) : std::string_view();
+    }
+
     bool parse_text(Context* ctx, Container* ptr, MarkChain& mark_chain) {
         bool ret = true;
 
@@ -610,80 +738,58 @@ namespace AB {
         OFFSET text_off = bound_it->beg;
 
         TEXT_TYPE t_type = TEXT_NORMAL;
-        for (auto it = mark_chain.begin();it != mark_chain.end();it++) {
-            auto& mark = *it;
+        for (auto& mark : mark_chain.marks) {
+            if (mark.erased)
+                continue;
             if (!mark.is_closing) {
                 /* Create href details for links */
-                SpanDetailPtr detail = nullptr;
+                SpanDetail detail;
+                const Boundaries& bound = mark_chain.last_bound(mark);
                 if (mark.s_type & (S_LINK | S_LINKDEF)) {
-                    OFFSET start = mark.true_bounds.back().end + 2;
-                    OFFSET end = mark.true_bounds.back().post - 1;
-                    auto tmp = std::make_shared<SpanADetail>();
-                    for (OFFSET off = start;off < end;off++) {
-                        tmp->href += CH(off);
-                    }
+                    SpanADetail a_detail;
+                    a_detail.href = text_view(ctx, bound.end + 2, bound.post - 1);
                     if (mark.s_type & S_LINKDEF)
-                        tmp->alias = true;
-                    detail = tmp;
+                        a_detail.alias = true;
+                    detail = a_detail;
                 }
                 else if (mark.s_type == S_AUTOLINK) {
-                    OFFSET start = mark.true_bounds.back().pre;
-                    OFFSET end = mark.true_bounds.back().end;
-                    auto tmp = std::make_shared<SpanADetail>();
-                    for (OFFSET off = start;off < end;off++) {
-                        tmp->href += CH(off);
-                    }
-                    detail = tmp;
+                    SpanADetail a_detail;
+                    a_detail.href = text_view(ctx, bound.pre, bound.end);
+                    detail = a_detail;
                 }
 
                 else if (mark.s_type & SELECT_IMGS) {
-                    OFFSET start = mark.true_bounds.back().beg;
-                    OFFSET end = mark.true_bounds.back().end;
-                    OFFSET post = mark.true_bounds.back().post;
-                    auto tmp = std::make_shared<SpanImgDetail>();
+                    SpanImgDetail img_detail;
                     if (mark.s_type & S_IMG) {
-                        for (OFFSET off = start;off < end;off++) {
-                            tmp->src += CH(off);
-                        }
+                        img_detail.src = text_view(ctx, bound.beg, bound.end);
                     }
                     else {
-                        for (OFFSET off = start;off < end;off++) {
-                            tmp->title += CH(off);
-                        }
-                        for (OFFSET off = end + 2;off < post - 1;off++) {
-                            tmp->src += CH(off);
-                        }
+                        img_detail.title = text_view(ctx, bound.beg, bound.end);
+                        img_detail.src = text_view(ctx, bound.end + 2, bound.post - 1);
                     }
                     if (mark.s_type & S_IMG_DEF)
-                        tmp->alias = true;
-                    detail = tmp;
+                        img_detail.alias = true;
+                    detail = img_detail;
                 }
                 else if (mark.s_type & SELECT_REFS) {
-                    OFFSET start = mark.true_bounds.back().beg;
-                    OFFSET end = mark.true_bounds.back().end;
-                    auto tmp = std::make_shared<SpanRefDetail>();
-                    for (OFFSET off = start;off < end;off++) {
-                        tmp->name += CH(off);
-                    }
+                    SpanRefDetail ref_detail;
+                    ref_detail.name = text_view(ctx, bound.beg, bound.end);
                     if (mark.s_type & S_INSERTED_REF)
-                        tmp->inserted = true;
-                    detail = tmp;
+                        ref_detail.inserted = true;
+                    detail = ref_detail;
                 }
 
                 /* Insert text left to span */
-                CHECK_AND_RET(create_text(ctx, bound_it, bound_end, TEXT_NORMAL, text_off, mark.true_bounds.front().pre));
-                text_off = mark.true_bounds.front().beg;
-
-                CHECK_AND_RET(ctx->parser->enter_span(
-                    flag_to_type(mark.s_type),
-                    mark.true_bounds,
-                    mark.attributes,
-                    detail
-                ));
+                BoundariesView true_bounds = mark_chain.true_bounds(mark);
+                CHECK_AND_RET(create_text(ctx, bound_it, bound_end, TEXT_NORMAL, text_off, true_bounds.front().pre));
+                text_off = true_bounds.front().beg;
+
+                const Attributes& attributes = (mark.attributes < 0) ? empty_attributes : mark_chain.attributes[mark.attributes];
+                emit_enter_span(ctx, flag_to_type(mark.s_type), true_bounds, attributes, detail);
             }
             else {
                 /* Insert text from inside span */
-                auto bound = mark.start_ptr->true_bounds.back();
+                auto bound = mark_chain.last_bound(mark_chain.marks[mark.start]);
                 bool has_text = true;
                 TEXT_TYPE type = TEXT_NORMAL;
                 if (mark.s_type == S_LATEX) {
@@ -699,7 +805,7 @@ namespace AB {
                     CHECK_AND_RET(create_text(ctx, bound_it, bound_end, type, text_off, bound.end));
                 text_off = bound.post;
 
-                CHECK_AND_RET(ctx->parser->leave_span(flag_to_type(mark.s_type)));
+                emit_leave_span(ctx, flag_to_type(mark.s_type));
             }
         }
         CHECK_AND_RET(create_text(ctx, bound_it, bound_end, t_type, text_off, ptr->content_boundaries.back().end));
@@ -709,11 +815,92 @@ namespace AB {
         return ret;
     }
 
+    /* Below this amount of text in the leaves of a batch, the
+     * spans are not worth sharing between threads */
+    static const SIZE MIN_CONCURRENT_SPANS_SIZE = 1 << 12;
+
+    /* Kept from one leaf block to another to reuse their memory */
+    struct SpanBuffers {
+        Context* ctx;
+        MarkChain mark_chain;
+        /* Leaves whose spans are resolved concurrently, and their marks */
+        std::vector<Container*> leaves;
+        std::vector<MarkChain> mark_chains;
+        /* Blocks whose leaves are not collected yet (see collect_leaves) */
+        std::vector<Container*> pending;
+    };
+
+    static SpanBuffers* get_span_buffers(Context* ctx) {
+        if (ctx->span_buffers == nullptr)
+            ctx->span_buffers = std::make_shared<SpanBuffers>();
+        /* The buffers of a session go from one context to another */
+        ctx->span_buffers->ctx = ctx;
+        return ctx->span_buffers.get();
+    }
+
+    /* Only reads the text and the container, so it can run on any thread */
+    static void resolve_spans(SIZE job, void* data) {
+        SpanBuffers* buffers = static_cast<SpanBuffers*>(data);
+        main_loop(buffers->ctx, buffers->leaves[job], buffers->mark_chains[job]);
+        mark_cleanup(buffers->ctx, buffers->mark_chains[job]);
+    }
+
+    /* Collects the leaves of the blocks in buffers->pending and under them, in any order */
+    static void collect_leaves(SpanBuffers* buffers, SIZE* size) {
+        auto& pending = buffers->pending;
+        while (!pending.empty()) {
+            Container* ptr = pending.back();
+            pending.pop_back();
+            /* Same blocks as the ones sent by enter_block() */
+            if (ptr->b_type == BLOCK_EMPTY)
+                continue;
+            if (ptr->b_type == BLOCK_P || ptr->b_type == BLOCK_H) {
+                buffers->leaves.push_back(ptr);
+                for (const auto& bound : ptr->content_boundaries)
+                    *size += bound.end - bound.beg;
+            }
+            pending.insert(pending.end(), ptr->children.begin(), ptr->children.end());
+        }
+    }
+
+    void resolve_spans_concurrently(Context* ctx, Container* root, bool closed_only) {
+        SpanBuffers* buffers = get_span_buffers(ctx);
+        buffers->leaves.clear();
+        buffers->pending.clear();
+        if (closed_only) {
+            /* Blocks sent by send_closed_blocks(): the children of the unfinished
+             * blocks but the last one, which may be unfinished too */
+            for (Container* ptr = root;!ptr->children.empty() && !is_leaf_block(ptr->b_type);ptr = ptr->children.back())
+                buffers->pending.insert(buffers->pending.end(), ptr->children.begin(), ptr->children.end() - 1);
+        }
+        else {
+            buffers->pending.insert(buffers->pending.end(), root->children.begin(), root->children.end());
+        }
+        SIZE size = 0;
+        collect_leaves(buffers, &size);
+        if (buffers->leaves.size() < 2 || size < MIN_CONCURRENT_SPANS_SIZE)
+            return;
+
+        if (buffers->mark_chains.size() < buffers->leaves.size())
+            buffers->mark_chains.resize(buffers->leaves.size());
+        for (SIZE i = 0;i < buffers->leaves.size();i++) {
+            buffers->mark_chains[i].clear();
+            buffers->leaves[i]->span_job = (int)i;
+        }
+        ctx->pool->run((SIZE)buffers->leaves.size(), &resolve_spans, buffers);
+    }
+
     bool parse_spans(Context* ctx, Container* ptr) {
         bool ret = true;
 
-        MarkChain mark_chain;
-        if (ptr->b_type != BLOCK_CODE && ptr->b_type != BLOCK_LATEX) {
+        if (ptr->span_job >= 0) {
+            /* Already resolved by resolve_spans_concurrently() */
+            parse_text(ctx, ptr, get_span_buffers(ctx)->mark_chains[ptr->span_job]);
+            ptr->span_job = -1;
+        }
+        else if (ptr->b_type != BLOCK_CODE && ptr->b_type != BLOCK_LATEX) {
+            MarkChain& mark_chain = get_span_buffers(ctx)->mark_chain;
+            mark_chain.clear();
             main_loop(ctx, ptr, mark_chain);
             mark_cleanup(ctx, mark_chain);
             parse_text(ctx, ptr, mark_chain);
@@ -6,4 +6,8 @@
 
 namespace AB {
     bool parse_spans(Context* ctx, Container* ptr);
+    /* Resolves the spans of the leaf blocks under root on ctx->pool, before
+     * they are sent by parse_spans(). If closed_only, only the ones
+     * sent by send_closed_blocks() are resolved */
+    void resolve_spans_concurrently(Context* ctx, Container* root, bool closed_only = false);
 };
\ No newline at end of file
@@ -35,35 +35,39 @@
 
 #include <iostream>
 #include <memory>
+#include <algorithm>
 
 
 namespace AB {
-    /* It should 100% be possible to avoid this memory
-     * hungry function, but for now it is very convenient */
+    /* Stores the offset at which each line begins, line numbers
+     * of offsets are then found with offset_to_line_number()
+     *
+     * Only the lines between ctx->start and ctx->end are stored */
     void generate_line_number_data(Context* ctx) {
-        ctx->offset_to_line_number.reserve(ctx->end + 1);
-        /* The first seg always starts at 0 */
-        ctx->line_number_begs.push_back(0);
-        int line_counter = 0;
-        for (unsigned int i = 0;i < ctx->end;i++) {
-            // if (i + 1 < ctx->start) {
-            //     if ((*ctx->text)[i] == '\n')
-            //         line_counter++;
-            //     continue;
-            // }
-            ctx->offset_to_line_number.push_back(line_counter);
-            if ((*ctx->text)[i] == '\n') {
-                line_counter++;
-                if (i + 1 <= ctx->end)
-                    ctx->line_number_begs.push_back(i + 1);
+        /* The first seg always starts at ctx->start */
+        ctx->line_number_begs.push_back(ctx->start);
+        const auto& index = ctx->structural_index;
+        const auto& newlines = index.newlines;
+        for (SIZE word_idx = 0;word_idx < newlines.size();word_idx++) {
+            uint64_t word = newlines[word_idx];
+            /* Ignore the newlines before start in the first word */
+            if (word_idx == 0)
+                word &= ~0ULL << (ctx->start - index.base);
+            while (word) {
+                ctx->line_number_begs.push_back((int)(index.base + word_idx * 64 + count_trailing_zeros(word) + 1));
+                word &= word - 1;
             }
         }
-        ctx->offset_to_line_number.push_back(line_counter);
     }
 
     bool process_doc(Context* ctx) {
         bool ret = true;
+        /* Without a session, the containers only live during the parsing */
+        ContainerSlab containers;
+        if (ctx->containers == nullptr)
+            ctx->containers = &containers;
 
+        build_structural_index(ctx);
         generate_line_number_data(ctx);
 
         /* First, process all the blocks that we
@@ -71,22 +75,166 @@ namespace AB {
         CHECK_AND_RET(parse_blocks(ctx));
 
     abort:
+        if (ctx->containers == &containers)
+            ctx->containers = nullptr;
         return ret;
     }
 
-    bool parse(const std::string* text, OFFSET start, OFFSET end, const Parser* parser) {
+    void take_session_buffers(Context* ctx, SessionBuffers* session) {
+        if (session == nullptr)
+            return;
+        ctx->containers = &session->containers;
+        ctx->max_unsent_blocks = session->max_unsent_blocks;
+        std::swap(ctx->free_containers, session->free_containers);
+        std::swap(ctx->open_containers, session->open_containers);
+        std::swap(ctx->block_stack, session->block_stack);
+        std::swap(ctx->events, session->events);
+        std::swap(ctx->event_bounds, session->event_bounds);
+        std::swap(ctx->event_attributes, session->event_attributes);
+        std::swap(ctx->event_span_details, session->event_span_details);
+        std::swap(ctx->detail_strings, session->detail_strings);
+        std::swap(ctx->structural_index, session->structural_index);
+        std::swap(ctx->line_number_begs, session->line_number_begs);
+        std::swap(ctx->span_buffers, session->span_buffers);
+        /* Left over if the previous parse was stopped */
+        ctx->events.clear();
+        ctx->event_bounds.clear();
+        ctx->event_attributes.clear();
+        ctx->event_span_details.clear();
+        ctx->detail_strings.clear();
+        ctx->line_number_begs.clear();
+    }
+
+    void return_session_buffers(Context* ctx, SessionBuffers* session) {
+        if (session == nullptr)
+            return;
+        ctx->containers = nullptr;
+        std::swap(ctx->free_containers, session->free_containers);
+        std::swap(ctx->open_containers, session->open_containers);
+        std::swap(ctx->block_stack, session->block_stack);
+        std::swap(ctx->events, session->events);
+        std::swap(ctx->event_bounds, session->event_bounds);
+        std::swap(ctx->event_attributes, session->event_attributes);
+        std::swap(ctx->event_span_details, session->event_span_details);
+        std::swap(ctx->detail_strings, session->detail_strings);
+        std::swap(ctx->structural_index, session->structural_index);
+        std::swap(ctx->line_number_begs, session->line_number_begs);
+        std::swap(ctx->span_buffers, session->span_buffers);
+    }
+
+    bool parse_batches(SessionBuffers* session, const char* text, OFFSET start, OFFSET end, BatchFct batch_fct, void* user_data, ParseResult* result, int start_line, ThreadPool* pool) {
         Context ctx;
+        take_session_buffers(&ctx, session);
         ctx.text = text;
         ctx.start = start;
         ctx.end = end;
-        ctx.parser = parser;
+        ctx.batch_fct = batch_fct;
+        ctx.user_data = user_data;
+        ctx.pool = pool;
+        if (start_line < 0)
+            start_line = (int)std::count(text, text + start, '\n');
+        ctx.first_line_number = start_line;
+
+        if (result != nullptr) {
+            /* The vectors of the result keep their memory */
+            result->restart_offsets.clear();
+            result->restart_lines.clear();
+            result->start = start;
+            result->end = end;
+            result->reparsed_beg = start;
+            result->reparsed_end = end;
+            /* The beginning of the text is always a restart point */
+            result->restart_offsets.push_back(start);
+            result->restart_lines.push_back(start_line);
+            ctx.result = result;
+        }
+
+        process_doc(&ctx);
+        return_session_buffers(&ctx, session);
+
+        return 0;
+    }
+
+    bool parse_batches(const char* text, OFFSET start, OFFSET end, BatchFct batch_fct, void* user_data, ParseResult* result, int start_line, ThreadPool* pool) {
+        return parse_batches(nullptr, text, start, end, batch_fct, user_data, result, start_line, pool);
+    }
+
+    bool reparse_batches(SessionBuffers* session, const char* text, const ParseResult& previous, const TextEdit& edit, BatchFct batch_fct, void* user_data, ParseResult* result) {
+        const auto& points = previous.restart_offsets;
+        OFFSET delta = edit.new_end - edit.old_end;
+
+        /* The edit may change how the block before the edited one is terminated
+         * (e.g. removing the blank line between two paragraphs), this is why we
+         * restart from the block before */
+        int restart_idx = (int)(std::upper_bound(points.begin(), points.end(), edit.beg) - points.begin()) - 2;
+        if (restart_idx < 0)
+            restart_idx = 0;
+
+        ParseResult local_result;
+        ParseResult& new_result = (session != nullptr) ? session->result : local_result;
+        new_result.start = previous.start;
+        new_result.end = previous.end + delta;
+        new_result.reparsed_beg = (points.empty()) ? previous.start : points[restart_idx];
+        new_result.reparsed_end = new_result.end;
+        new_result.restart_offsets.assign(points.begin(), points.begin() + restart_idx);
+        new_result.restart_offsets.push_back(new_result.reparsed_beg);
+        /* The text before the restart point is unchanged, so is its line number */
+        new_result.restart_lines.assign(previous.restart_lines.begin(), previous.restart_lines.begin() + restart_idx);
+        new_result.restart_lines.push_back((points.empty()) ? 0 : previous.restart_lines[restart_idx]);
+
+        Context ctx;
+        take_session_buffers(&ctx, session);
+        ctx.text = text;
+        ctx.start = new_result.reparsed_beg;
+        ctx.end = new_result.end;
+        ctx.batch_fct = batch_fct;
+        ctx.user_data = user_data;
+        ctx.first_line_number = new_result.restart_lines.back();
+        ctx.result = &new_result;
+        ctx.previous = &previous;
+        ctx.edit_new_end = edit.new_end;
+        ctx.edit_delta = delta;
 
         process_doc(&ctx);
 
-        for (auto ptr : ctx.containers) {
-            delete ptr;
+        /* Everything after the interruption is the same as in the previous parse */
+        if (ctx.interrupted) {
+            auto it = std::lower_bound(points.begin(), points.end(), new_result.reparsed_end - delta);
+            SIZE idx = (SIZE)(it - points.begin());
+            int line_delta = offset_to_line_number(&ctx, new_result.reparsed_end) - previous.restart_lines[idx];
+            for (;idx < points.size();idx++) {
+                new_result.restart_offsets.push_back(points[idx] + delta);
+                new_result.restart_lines.push_back(previous.restart_lines[idx] + line_delta);
+            }
         }
+        return_session_buffers(&ctx, session);
+        /* The session keeps the memory of the previous result for the next re-parse */
+        std::swap(*result, new_result);
 
         return 0;
     }
+
+    bool reparse_batches(const char* text, const ParseResult& previous, const TextEdit& edit, BatchFct batch_fct, void* user_data, ParseResult* result) {
+        return reparse_batches(nullptr, text, previous, edit, batch_fct, user_data, result);
+    }
+
+    bool parse(const std::string* text, OFFSET start, OFFSET end, const Parser* parser, ParseResult* result, int start_line, ThreadPool* pool) {
+        ParserVisitor visitor{ parser };
+        return parse(text, start, end, visitor, result, start_line, pool);
+    }
+
+    bool reparse(const std::string* text, const ParseResult& previous, const TextEdit& edit, const Parser* parser, ParseResult* result) {
+        ParserVisitor visitor{ parser };
+        return reparse(text, previous, edit, visitor, result);
+    }
+
+    bool parse_parallel(const std::string* text, const Parser* parser, int num_threads) {
+        ParserVisitor visitor{ parser };
+        return parse_parallel(text, visitor, num_threads);
+    }
+
+    bool parse_file(const std::string& path, const Parser* parser, ParseResult* result) {
+        ParserVisitor visitor{ parser };
+        return parse_file(path, visitor, result);
+    }
 }
\ No newline at end of file
@@ -7,9 +7,60 @@
 
 #include "definitions.h"
 #include "helpers.h"
+#include "events.h"
+#include "parallel.h"
+#include "session.h"
+#include "stream.h"
+#include "thread_pool.h"
+#include "tree.h"
 
 
 // Implementation is inspired from http://github.com/mity/md4c
 namespace AB {
-    bool parse(const std::string* text, OFFSET start, OFFSET end, const Parser* parser);
+    /**
+     * Parses the text between start and end and sends the blocks and spans
+     * to the callbacks of the parser
+     *
+     * The callbacks are called through std::function, prefer the templated
+     * parse(text, start, end, visitor) (see events.h) when performance matters
+     *
+     * If result is not null, it is filled with the informations needed by reparse()
+     *
+     * start_line is the line number of start. If it is negative, the lines before
+     * start are counted, pass it to only do work proportional to end - start
+     *
+     * If pool is not null, the spans are resolved on its threads (see ThreadPool)
+    */
+    bool parse(const std::string* text, OFFSET start, OFFSET end, const Parser* parser, ParseResult* result = nullptr, int start_line = -1, ThreadPool* pool = nullptr);
+
+    /**
+     * Re-parses the text after an edit, given the result of the previous parse
+     *
+     * Only the DOC-level blocks affected by the edit are sent to the callbacks
+     * (enclosed in a BLOCK_DOC). These blocks span [result->reparsed_beg, result->reparsed_end)
+     * in the new text, and replace the blocks of the previous parse which started in
+     * [result->reparsed_beg, result->reparsed_end - (edit.new_end - edit.old_end)).
+     * The blocks after are unchanged, except that their offsets are shifted by
+     * edit.new_end - edit.old_end and their line numbers by the number of lines
+     * added by the edit.
+     *
+     * result may point to previous
+    */
+    bool reparse(const std::string* text, const ParseResult& previous, const TextEdit& edit, const Parser* parser, ParseResult* result);
+
+    /**
+     * Parses the whole file, which is memory-mapped instead of being copied
+     *
+     * The file is unmapped when the function returns, callers which need the text
+     * in the callbacks should open a MappedFile and parse its data() themselves
+     *
+     * Returns false if the file can't be opened
+    */
+    bool parse_file(const std::string& path, const Parser* parser, ParseResult* result = nullptr);
+
+    /**
+     * Parses the whole text on num_threads threads, the callbacks receive the same
+     * events as with parse(), from the calling thread (see parse_parallel_batches)
+    */
+    bool parse_parallel(const std::string* text, const Parser* parser, int num_threads);
 };
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include "session.h"
+#include "internal.h"
+
+namespace AB {
+    ParserSession::ParserSession(): m_buffers(std::make_unique<SessionBuffers>()) {
+    }
+
+    ParserSession::~ParserSession() = default;
+
+    bool ParserSession::parse_batches(const char* text, OFFSET start, OFFSET end, BatchFct batch_fct, void* user_data, ParseResult* result, int start_line, ThreadPool* pool) {
+        m_buffers->max_unsent_blocks = max_unsent_blocks;
+        return AB::parse_batches(m_buffers.get(), text, start, end, batch_fct, user_data, result, start_line, pool);
+    }
+
+    bool ParserSession::reparse_batches(const char* text, const ParseResult& previous, const TextEdit& edit, BatchFct batch_fct, void* user_data, ParseResult* result) {
+        m_buffers->max_unsent_blocks = max_unsent_blocks;
+        return AB::reparse_batches(m_buffers.get(), text, previous, edit, batch_fct, user_data, result);
+    }
+
+    bool ParserSession::parse(const std::string* text, OFFSET start, OFFSET end, const Parser* parser, ParseResult* result, int start_line, ThreadPool* pool) {
+        ParserVisitor visitor{ parser };
+        return parse(text, start, end, visitor, result, start_line, pool);
+    }
+
+    bool ParserSession::reparse(const std::string* text, const ParseResult& previous, const TextEdit& edit, const Parser* parser, ParseResult* result) {
+        ParserVisitor visitor{ parser };
+        return reparse(text, previous, edit, visitor, result);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "definitions.h"
+#include "events.h"
+
+namespace AB {
+    struct SessionBuffers;
+
+    /**
+     * Parser which keeps its memory from one parse to another
+     *
+     * The buffers of a parse (containers of the blocks, line table, structural
+     * index, marks of the spans, events and scratch strings) are kept by the session
+     * with their capacity, and reused by its next parse() or reparse(). Once the
+     * session has parsed a text, parsing again a text of the same size and structure
+     * makes no heap allocation, apart from the ones of the callbacks (the std::function
+     * of a Parser do not allocate when called). An editor re-parsing its document after
+     * each edit should keep one session for it.
+     *
+     * The ParseResult given to parse() keeps its capacity too, and reparse() swaps the
+     * result with the one of the session.
+     *
+     * A session must not be used by several threads at the same time, nor from
+     * the callbacks of one of its parses
+     *
+     * Usage:
+     *
+     *     AB::ParserSession session;
+     *     session.parse(&text, 0, (AB::OFFSET)text.length(), &parser, &result);
+     *     ...
+     *     session.reparse(&text, result, edit, &parser, &result);
+     */
+    class ParserSession {
+    public:
+        ParserSession();
+        ~ParserSession();
+        ParserSession(const ParserSession&) = delete;
+        ParserSession& operator=(const ParserSession&) = delete;
+
+        /* Same as AB::parse_batches() and AB::reparse_batches() */
+        bool parse_batches(const char* text, OFFSET start, OFFSET end, BatchFct batch_fct, void* user_data, ParseResult* result = nullptr, int start_line = -1, ThreadPool* pool = nullptr);
+        bool reparse_batches(const char* text, const ParseResult& previous, const TextEdit& edit, BatchFct batch_fct, void* user_data, ParseResult* result);
+
+        /* Same as AB::parse() and AB::reparse() */
+        bool parse(const std::string* text, OFFSET start, OFFSET end, const Parser* parser, ParseResult* result = nullptr, int start_line = -1, ThreadPool* pool = nullptr);
+        bool reparse(const std::string* text, const ParseResult& previous, const TextEdit& edit, const Parser* parser, ParseResult* result);
+
+        template<typename Visitor>
+        bool parse(const std::string* text, OFFSET start, OFFSET end, Visitor& visitor, ParseResult* result = nullptr, int start_line = -1, ThreadPool* pool = nullptr) {
+            return parse_batches(text->data(), start, end, &dispatch_batch<Visitor>, &visitor, result, start_line, pool);
+        }
+        template<typename Visitor>
+        bool reparse(const std::string* text, const ParseResult& previous, const TextEdit& edit, Visitor& visitor, ParseResult* result) {
+            return reparse_batches(text->data(), previous, edit, &dispatch_batch<Visitor>, &visitor, result);
+        }
+
+        /**
+         * If not 0, the closed blocks of a DOC-level block are sent before the block is
+         * finished, as soon as the unfinished block has more than this number of blocks.
+         * E.g. the items of a long list are sent while the list is parsed, and the memory
+         * of the ones sent is reused by the next ones.
+         *
+         * The unfinished blocks containing the sent ones are entered first, the
+         * boundaries of their enter_block() are only the ones known at that time
+         */
+        SIZE max_unsent_blocks = 0;
+    private:
+        std::unique_ptr<SessionBuffers> m_buffers;
+    };
+}
@@ -0,0 +1,109 @@
+#include "stream.h"
+#include "internal.h"
+
+#include <algorithm>
+
+namespace AB {
+    StreamParser::StreamParser(const Parser* parser)
+        : m_parser_visitor{ parser }, m_batch_fct(&dispatch_batch<ParserVisitor>), m_user_data(&m_parser_visitor),
+        m_session(std::make_unique<SessionBuffers>()) {
+    }
+
+    StreamParser::StreamParser(BatchFct batch_fct, void* user_data)
+        : m_parser_visitor{ nullptr }, m_batch_fct(batch_fct), m_user_data(user_data),
+        m_session(std::make_unique<SessionBuffers>()) {
+    }
+
+    StreamParser::~StreamParser() = default;
+
+    bool StreamParser::feed(const char* data, SIZE len) {
+        if (m_stopped || m_finished)
+            return !m_stopped;
+        m_buffer.append(data, len);
+        if (m_buffer.size() < m_next_parse_size)
+            return true;
+        return parse_buffer(true);
+    }
+
+    bool StreamParser::finish() {
+        if (m_stopped || m_finished)
+            return !m_stopped;
+        m_finished = true;
+        bool ret = parse_buffer(false);
+        m_buffer.clear();
+        return ret;
+    }
+
+    bool StreamParser::parse_buffer(bool partial) {
+        /* The last line may not be complete yet */
+        OFFSET end = (OFFSET)m_buffer.size();
+        if (partial) {
+            auto pos = m_buffer.rfind('\n');
+            end = (pos == std::string::npos) ? 0 : (OFFSET)pos + 1;
+        }
+
+        m_session->max_unsent_blocks = max_unsent_blocks;
+        ParseResult result;
+        result.restart_offsets.push_back(0);
+        result.restart_lines.push_back(m_buffer_line);
+
+        Context ctx;
+        take_session_buffers(&ctx, m_session.get());
+        ctx.text = m_buffer.data();
+        ctx.start = 0;
+        ctx.end = end;
+        ctx.first_line_number = m_buffer_line;
+        ctx.batch_fct = &StreamParser::send_batch;
+        ctx.user_data = this;
+        ctx.result = &result;
+        ctx.partial = partial;
+        ctx.skip_doc_enter = m_doc_entered;
+        ctx.skip_batches = m_sent_batches;
+
+        process_doc(&ctx);
+        return_session_buffers(&ctx, m_session.get());
+
+        m_stopped = ctx.stopped;
+        if (m_stopped || !partial)
+            return !m_stopped;
+
+        /* Everything before the last restart point has been sent, and the parsing
+         * of the rest doesn't depend on it */
+        OFFSET restart = result.restart_offsets.back();
+        m_buffer_line = result.restart_lines.back();
+        m_sent_batches = ctx.batches_since_restart;
+        m_buffer.erase(0, restart);
+        m_buffer_offset += restart;
+        m_next_parse_size = std::max(min_parse_size, 2 * (SIZE)m_buffer.size());
+        return true;
+    }
+
+    bool StreamParser::send_batch(const std::vector<Event>& events, void* user_data) {
+        StreamParser* stream = static_cast<StreamParser*>(user_data);
+        if (!events.empty())
+            stream->m_doc_entered = true;
+        if (stream->m_buffer_offset == 0)
+            return stream->m_batch_fct(events, stream->m_user_data);
+
+        /* Shift the boundaries from the buffer to the document */
+        auto& bounds = stream->m_bounds;
+        bounds.clear();
+        for (const auto& event : events) {
+            for (const auto& bound : event.bounds) {
+                bounds.push_back(bound);
+                bounds.back().pre += stream->m_buffer_offset;
+                bounds.back().beg += stream->m_buffer_offset;
+                bounds.back().end += stream->m_buffer_offset;
+                bounds.back().post += stream->m_buffer_offset;
+            }
+        }
+        auto& shifted = stream->m_events;
+        shifted.assign(events.begin(), events.end());
+        const Boundaries* ptr = bounds.data();
+        for (auto& event : shifted) {
+            event.bounds.ptr = ptr;
+            ptr += event.bounds.count;
+        }
+        return stream->m_batch_fct(shifted, stream->m_user_data);
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+#include "events.h"
+
+namespace AB {
+    struct SessionBuffers;
+
+    /* =========
+     * Streaming
+     * ========= */
+
+    /**
+     * Parses a document given chunk by chunk
+     *
+     * The events of a DOC-level block are sent once the block is closed, i.e. when
+     * a following line starts a new DOC-level block. Only the text of the unfinished
+     * blocks is kept in memory.
+     *
+     * Offsets and line numbers in the events are counted from the beginning of the
+     * whole document. While the events are sent, the character at offset off
+     * is buffer()[off - buffer_offset()]
+     *
+     * Usage:
+     *
+     *     AB::StreamParser stream(&parser);
+     *     while (...)
+     *         stream.feed(data, len);
+     *     stream.finish();
+     */
+    class StreamParser {
+    public:
+        StreamParser(const Parser* parser);
+        template<typename Visitor>
+        StreamParser(Visitor& visitor): StreamParser(&dispatch_batch<Visitor>, &visitor) {}
+        StreamParser(BatchFct batch_fct, void* user_data);
+        ~StreamParser();
+        /* May refer to itself */
+        StreamParser(const StreamParser&) = delete;
+
+        /**
+         * Adds a chunk at the end of the document, and sends the blocks
+         * which have been closed by it
+         *
+         * Returns false if the user stopped the parsing
+         */
+        bool feed(const char* data, SIZE len);
+        /* Sends the remaining blocks and the end of DOC */
+        bool finish();
+
+        /* Minimum amount of text parsed at once, lower it to
+         * receive the blocks as soon as they are closed */
+        SIZE min_parse_size = 1 << 16;
+        /* Same as ParserSession::max_unsent_blocks, the closed blocks of a long
+         * unfinished block are sent without waiting for its end */
+        SIZE max_unsent_blocks = 0;
+
+        const std::string& buffer() const { return m_buffer; }
+        OFFSET buffer_offset() const { return m_buffer_offset; }
+    private:
+        ParserVisitor m_parser_visitor;
+        BatchFct m_batch_fct;
+        void* m_user_data;
+
+        /* Text from the beginning of the unfinished blocks */
+        std::string m_buffer;
+        /* Offset and line number of m_buffer[0] in the document */
+        OFFSET m_buffer_offset = 0;
+        int m_buffer_line = 0;
+        /* Batches already sent since the beginning of m_buffer */
+        int m_sent_batches = 0;
+        bool m_doc_entered = false;
+        bool m_stopped = false;
+        bool m_finished = false;
+        /* The buffer is only parsed again once it has reached this size,
+         * so that a long unfinished block is not parsed once per chunk */
+        SIZE m_next_parse_size = 0;
+
+        /* Buffers reused by each parse of the buffer */
+        std::unique_ptr<SessionBuffers> m_session;
+
+        /* Events with boundaries shifted by m_buffer_offset */
+        std::vector<Event> m_events;
+        std::vector<Boundaries> m_bounds;
+
+        bool parse_buffer(bool partial);
+        static bool send_batch(const std::vector<Event>& events, void* user_data);
+    };
+}
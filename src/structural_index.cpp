@@ -0,0 +1,123 @@
+#include "structural_index.h"
+#include "internal.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AB_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace AB {
+    static const uint8_t CLASS_NEWLINE = 0x1;
+    static const uint8_t CLASS_WHITESPACE = 0x2;
+    static const uint8_t CLASS_STRUCTURAL = 0x4;
+    static const uint8_t CLASS_SPAN = 0x8;
+
+    /* Lookup table for the scalar fallback */
+    struct ClassTable {
+        uint8_t classes[256] = { 0 };
+        ClassTable() {
+            classes[(unsigned char)'\n'] |= CLASS_NEWLINE;
+            for (char ch : { ' ', '\t', '\v', '\f' })
+                classes[(unsigned char)ch] |= CLASS_WHITESPACE;
+            for (const char* ch = STRUCTURAL_CHARS;*ch;ch++)
+                classes[(unsigned char)*ch] |= CLASS_STRUCTURAL;
+            for (const char* ch = SPAN_CHARS;*ch;ch++)
+                classes[(unsigned char)*ch] |= CLASS_SPAN;
+        }
+    };
+    static const ClassTable class_table;
+
+#if defined(__AVX2__)
+    static inline uint32_t movemask_eq_any(__m256i v, const char* chars) {
+        __m256i acc = _mm256_setzero_si256();
+        for (;*chars;chars++)
+            acc = _mm256_or_si256(acc, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(*chars)));
+        return (uint32_t)_mm256_movemask_epi8(acc);
+    }
+    /* Bits of the positions at which "http" starts, reads 3 bytes after the 32 */
+    static inline uint32_t movemask_http(const char* ptr) {
+        __m256i acc = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)ptr), _mm256_set1_epi8('h'));
+        for (int i = 1;i < 4;i++)
+            acc = _mm256_and_si256(acc, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(ptr + i)), _mm256_set1_epi8("http"[i])));
+        return (uint32_t)_mm256_movemask_epi8(acc);
+    }
+    static inline void classify_64(const char* ptr, uint64_t* newlines, uint64_t* whitespaces, uint64_t* structurals, uint64_t* span_chars) {
+        static const char ws_chars[] = " \t\v\f";
+        static const char nl_chars[] = "\n";
+        __m256i lo = _mm256_loadu_si256((const __m256i*)ptr);
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(ptr + 32));
+        *newlines = movemask_eq_any(lo, nl_chars) | ((uint64_t)movemask_eq_any(hi, nl_chars) << 32);
+        *whitespaces = movemask_eq_any(lo, ws_chars) | ((uint64_t)movemask_eq_any(hi, ws_chars) << 32);
+        *structurals = movemask_eq_any(lo, STRUCTURAL_CHARS) | ((uint64_t)movemask_eq_any(hi, STRUCTURAL_CHARS) << 32);
+        *span_chars = (movemask_eq_any(lo, SPAN_CHARS) | movemask_http(ptr))
+            | ((uint64_t)(movemask_eq_any(hi, SPAN_CHARS) | movemask_http(ptr + 32)) << 32);
+    }
+#elif defined(AB_USE_SSE2)
+    static inline uint64_t movemask_eq_any(__m128i v, const char* chars) {
+        __m128i acc = _mm_setzero_si128();
+        for (;*chars;chars++)
+            acc = _mm_or_si128(acc, _mm_cmpeq_epi8(v, _mm_set1_epi8(*chars)));
+        return (uint64_t)(uint16_t)_mm_movemask_epi8(acc);
+    }
+    /* Bits of the positions at which "http" starts, reads 3 bytes after the 16 */
+    static inline uint64_t movemask_http(const char* ptr) {
+        __m128i acc = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)ptr), _mm_set1_epi8('h'));
+        for (int i = 1;i < 4;i++)
+            acc = _mm_and_si128(acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(ptr + i)), _mm_set1_epi8("http"[i])));
+        return (uint64_t)(uint16_t)_mm_movemask_epi8(acc);
+    }
+    static inline void classify_64(const char* ptr, uint64_t* newlines, uint64_t* whitespaces, uint64_t* structurals, uint64_t* span_chars) {
+        static const char ws_chars[] = " \t\v\f";
+        static const char nl_chars[] = "\n";
+        *newlines = 0;
+        *whitespaces = 0;
+        *structurals = 0;
+        *span_chars = 0;
+        for (int i = 0;i < 4;i++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(ptr + 16 * i));
+            *newlines |= movemask_eq_any(v, nl_chars) << (16 * i);
+            *whitespaces |= movemask_eq_any(v, ws_chars) << (16 * i);
+            *structurals |= movemask_eq_any(v, STRUCTURAL_CHARS) << (16 * i);
+            *span_chars |= (movemask_eq_any(v, SPAN_CHARS) | movemask_http(ptr + 16 * i)) << (16 * i);
+        }
+    }
+#endif
+
+    void build_structural_index(Context* ctx) {
+        auto& index = ctx->structural_index;
+        index.base = ctx->start - ctx->start % 64;
+        /* Offsets are relative to the base from here */
+        const char* text = ctx->text + index.base;
+        SIZE size = (ctx->end > index.base) ? ctx->end - index.base : 0;
+        SIZE num_words = (size + 63) / 64;
+        index.newlines.assign(num_words, 0);
+        index.whitespaces.assign(num_words, 0);
+        index.structurals.assign(num_words, 0);
+        index.span_chars.assign(num_words, 0);
+
+        SIZE i = 0;
+#if defined(__AVX2__) || defined(AB_USE_SSE2)
+        /* The search of "http" reads 3 bytes after the word, only the
+         * byte at size is readable after the text */
+        for (;i + 64 + 2 <= size;i += 64) {
+            classify_64(text + i, &index.newlines[i / 64], &index.whitespaces[i / 64], &index.structurals[i / 64], &index.span_chars[i / 64]);
+        }
+#endif
+        /* Scalar fallback, also used for the last incomplete word */
+        for (;i < size;i++) {
+            uint8_t classes = class_table.classes[(unsigned char)text[i]];
+            uint64_t bit = 1ULL << (i % 64);
+            if (classes & CLASS_NEWLINE)
+                index.newlines[i / 64] |= bit;
+            if (classes & CLASS_WHITESPACE)
+                index.whitespaces[i / 64] |= bit;
+            if (classes & CLASS_STRUCTURAL)
+                index.structurals[i / 64] |= bit;
+            /* "http" can't start in the last 3 bytes of the text */
+            if ((classes & CLASS_SPAN) || (text[i] == 'h' && i + 3 < size && text[i + 1] == 't' && text[i + 2] == 't' && text[i + 3] == 'p'))
+                index.span_chars[i / 64] |= bit;
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "definitions.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace AB {
+    struct Context;
+
+    /**
+     * Bitmaps of the text, with one bit per byte:
+     * bit (off % 64) of word ((off - base) / 64) is set if CH(off) is part of the class
+     *
+     * Like in simdjson, the whole text is classified once (with SSE2 or AVX2 when
+     * available), so the parsers can jump from candidate to candidate instead of
+     * testing the characters one by one
+     */
+    struct StructuralIndex {
+        /* First classified offset (ctx->start rounded down to a multiple of 64) */
+        OFFSET base = 0;
+        /* '\n' */
+        std::vector<uint64_t> newlines;
+        /* ' ', '\t', '\v', '\f' (see ISWHITESPACE) */
+        std::vector<uint64_t> whitespaces;
+        /* Characters which can start or end a block or a span, see STRUCTURAL_CHARS */
+        std::vector<uint64_t> structurals;
+        /* Characters to which the span main_loop reacts: SPAN_CHARS, and the 'h'
+         * of "http" (other 'h' can't start an autolink) */
+        std::vector<uint64_t> span_chars;
+    };
+
+    /* Characters to which analyse_segment and the span main_loop react */
+    static const char STRUCTURAL_CHARS[] = "#>*-+([{!$_`=]}\\:";
+    /* Delimiters of the spans (see marks[] in parse_spans.cpp) and '\\' */
+    static constexpr char SPAN_CHARS[] = "*-+[{!$_`=]}\\";
+
+    /* Classifies the text between ctx->start and ctx->end */
+    void build_structural_index(Context* ctx);
+
+    inline int count_trailing_zeros(uint64_t word) {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        _BitScanForward64(&idx, word);
+        return (int)idx;
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+
+    /**
+     * Returns the first offset in [off, end) which has its bit set in the
+     * bitmap (whose first bit is base), or end if there is none
+    */
+    inline OFFSET find_next_set(const std::vector<uint64_t>& bitmap, OFFSET base, OFFSET off, OFFSET end) {
+        if (off >= end)
+            return end;
+        SIZE word_idx = (off - base) / 64;
+        uint64_t word = bitmap[word_idx] & (~0ULL << (off % 64));
+        while (true) {
+            if (word) {
+                OFFSET found = base + (OFFSET)(word_idx * 64 + count_trailing_zeros(word));
+                return (found < end) ? found : end;
+            }
+            word_idx++;
+            if (base + (OFFSET)(word_idx * 64) >= end)
+                return end;
+            word = bitmap[word_idx];
+        }
+    }
+
+    /**
+     * Returns the first offset in [off, end) which doesn't have its bit set
+     * in the bitmap (whose first bit is base), or end if there is none
+    */
+    inline OFFSET find_next_unset(const std::vector<uint64_t>& bitmap, OFFSET base, OFFSET off, OFFSET end) {
+        if (off >= end)
+            return end;
+        SIZE word_idx = (off - base) / 64;
+        uint64_t word = ~bitmap[word_idx] & (~0ULL << (off % 64));
+        while (true) {
+            if (word) {
+                OFFSET found = base + (OFFSET)(word_idx * 64 + count_trailing_zeros(word));
+                return (found < end) ? found : end;
+            }
+            word_idx++;
+            if (base + (OFFSET)(word_idx * 64) >= end)
+                return end;
+            word = ~bitmap[word_idx];
+        }
+    }
+}
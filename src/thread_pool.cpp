@@ -0,0 +1,64 @@
+#include "thread_pool.h"
+
+namespace AB {
+    ThreadPool::ThreadPool(int num_threads) {
+        for (int i = 1;i < num_threads;i++)
+            m_threads.emplace_back(&ThreadPool::work_loop, this);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    void ThreadPool::run(SIZE num_tasks, TaskFct task_fct, void* data) {
+        if (m_threads.empty() || num_tasks <= 1) {
+            for (SIZE i = 0;i < num_tasks;i++)
+                task_fct(i, data);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task_fct = task_fct;
+            m_data = data;
+            m_num_tasks = num_tasks;
+            m_next_task = 0;
+            m_busy = (int)m_threads.size();
+            m_generation++;
+        }
+        m_wake.notify_all();
+        take_tasks();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_busy == 0; });
+    }
+
+    void ThreadPool::take_tasks() {
+        for (SIZE i = m_next_task++;i < m_num_tasks;i = m_next_task++)
+            m_task_fct(i, m_data);
+    }
+
+    void ThreadPool::work_loop() {
+        SIZE generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_quit || m_generation != generation; });
+                if (m_quit)
+                    return;
+                generation = m_generation;
+            }
+            take_tasks();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_busy--;
+            }
+            m_done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "definitions.h"
+
+namespace AB {
+    /**
+     * Threads kept alive between parses, which share the tasks given to run()
+     *
+     * A pool given to parse() resolves the spans of the leaf blocks of a DOC-level
+     * block concurrently (e.g. the paragraphs of a long list), the events are
+     * still sent in order from the calling thread. A pool must only be used by
+     * one parse at a time.
+     */
+    class ThreadPool {
+    public:
+        typedef void (*TaskFct)(SIZE task, void* data);
+
+        /* num_threads includes the calling thread, so num_threads - 1 threads are created */
+        explicit ThreadPool(int num_threads);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * Calls task_fct(i, data) for each i in [0, num_tasks), and returns once
+         * all the calls are done
+         *
+         * A thread which is done with its task takes the next one which is
+         * not started, so long tasks don't hold back the other threads
+         */
+        void run(SIZE num_tasks, TaskFct task_fct, void* data);
+
+        int num_threads() const { return (int)m_threads.size() + 1; }
+    private:
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+
+        TaskFct m_task_fct = nullptr;
+        void* m_data = nullptr;
+        SIZE m_num_tasks = 0;
+        std::atomic<SIZE> m_next_task{ 0 };
+        /* Incremented by each run(), so that each thread joins it once */
+        SIZE m_generation = 0;
+        /* Number of threads still working on the current run() */
+        int m_busy = 0;
+        bool m_quit = false;
+
+        void work_loop();
+        void take_tasks();
+    };
+}
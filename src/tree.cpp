@@ -0,0 +1,154 @@
+#include "tree.h"
+#include "parser.h"
+
+#include <string.h>
+
+namespace AB {
+    /* Copies count objects at the end of the arena (8 bytes aligned),
+     * and returns their offset in bytes */
+    template<typename T>
+    static SIZE arena_push(std::vector<uint64_t>& arena, const T* data, SIZE count) {
+        SIZE offset = (SIZE)arena.size() * sizeof(uint64_t);
+        SIZE num_bytes = (SIZE)sizeof(T) * count;
+        arena.resize(arena.size() + (num_bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        if (num_bytes > 0)
+            memcpy(reinterpret_cast<char*>(arena.data()) + offset, data, num_bytes);
+        return offset;
+    }
+
+    static TreeString push_string(std::vector<uint64_t>& arena, std::string_view str) {
+        return TreeString{ arena_push(arena, str.data(), (SIZE)str.size()), (SIZE)str.size() };
+    }
+
+    /* Visitor storing the events in the tree */
+    class TreeBuilder {
+    public:
+        TreeBuilder(Tree* tree): tree(tree) {}
+
+        bool enter_block(BLOCK_TYPE b_type, BoundariesView bounds, const Attributes& attributes, const BlockDetail& detail) {
+            TreeNode& node = open_node(NODE_BLOCK, b_type, bounds, attributes);
+            if (!std::holds_alternative<std::monostate>(detail))
+                set_detail(node, make_block_detail(detail));
+            return true;
+        }
+        bool leave_block(BLOCK_TYPE) {
+            close_node();
+            return true;
+        }
+        bool enter_span(SPAN_TYPE s_type, BoundariesView bounds, const Attributes& attributes, const SpanDetail& detail) {
+            TreeNode& node = open_node(NODE_SPAN, s_type, bounds, attributes);
+            if (!std::holds_alternative<std::monostate>(detail))
+                set_detail(node, make_span_detail(detail));
+            return true;
+        }
+        bool leave_span(SPAN_TYPE) {
+            close_node();
+            return true;
+        }
+        bool text(TEXT_TYPE t_type, BoundariesView bounds) {
+            open_node(NODE_TEXT, t_type, bounds, empty_attributes);
+            close_node();
+            return true;
+        }
+    private:
+        Tree* tree;
+        /* Indices of the nodes which are not closed yet */
+        std::vector<int> open_nodes;
+        const Attributes empty_attributes;
+
+        TreeNode& open_node(NODE_KIND kind, int type, BoundariesView bounds, const Attributes& attributes) {
+            auto& arena = tree->arena;
+            TreeNode node;
+            node.kind = kind;
+            node.type = type;
+            node.parent = (open_nodes.empty()) ? -1 : open_nodes.back();
+            node.bounds_offset = arena_push(arena, bounds.data(), (SIZE)bounds.size());
+            node.bounds_size = (SIZE)bounds.size();
+            if (!attributes.empty()) {
+                /* Strings first, then the table of attributes which refers to them */
+                std::vector<TreeAttribute> tmp;
+                tmp.reserve(attributes.size());
+                for (auto& attribute : attributes)
+                    tmp.push_back({ push_string(arena, attribute.key), push_string(arena, attribute.value) });
+                node.attributes_offset = arena_push(arena, tmp.data(), (SIZE)tmp.size());
+                node.attributes_size = (SIZE)tmp.size();
+            }
+            open_nodes.push_back((int)tree->nodes.size());
+            tree->nodes.push_back(node);
+            return tree->nodes.back();
+        }
+        void close_node() {
+            int idx = open_nodes.back();
+            open_nodes.pop_back();
+            tree->nodes[idx].subtree_size = (int)tree->nodes.size() - idx;
+        }
+        void set_detail(TreeNode& node, const TreeDetail& detail) {
+            node.detail_offset = arena_push(tree->arena, &detail, 1);
+            node.has_detail = true;
+        }
+
+        TreeDetail make_block_detail(const BlockDetail& block_detail) {
+            TreeDetail detail;
+            auto& arena = tree->arena;
+            if (auto d = std::get_if<BlockCodeDetail>(&block_detail)) {
+                detail.text = push_string(arena, d->lang);
+                detail.number = d->num_ticks;
+            }
+            else if (auto d = std::get_if<BlockOlDetail>(&block_detail)) {
+                detail.marker = d->pre_marker;
+                detail.post_marker = d->post_marker;
+                detail.number = d->type;
+                detail.flag = d->lower_case;
+            }
+            else if (auto d = std::get_if<BlockUlDetail>(&block_detail)) {
+                detail.marker = d->marker;
+            }
+            else if (auto d = std::get_if<BlockLiDetail>(&block_detail)) {
+                detail.text = push_string(arena, d->number);
+                detail.number = d->level;
+                detail.state = d->task_state;
+                detail.flag = d->is_task;
+            }
+            else if (auto d = std::get_if<BlockDefDetail>(&block_detail)) {
+                detail.text = push_string(arena, d->name);
+                detail.number = d->definition_type;
+            }
+            else if (auto d = std::get_if<BlockDivDetail>(&block_detail)) {
+                detail.text = push_string(arena, d->name);
+            }
+            else if (auto d = std::get_if<BlockHDetail>(&block_detail)) {
+                detail.number = d->level;
+            }
+            return detail;
+        }
+        TreeDetail make_span_detail(const SpanDetail& span_detail) {
+            TreeDetail detail;
+            auto& arena = tree->arena;
+            if (auto d = std::get_if<SpanADetail>(&span_detail)) {
+                detail.text = push_string(arena, d->href);
+                detail.flag = d->alias;
+            }
+            else if (auto d = std::get_if<SpanImgDetail>(&span_detail)) {
+                detail.text = push_string(arena, d->src);
+                detail.title = push_string(arena, d->title);
+                detail.flag = d->alias;
+            }
+            else if (auto d = std::get_if<SpanRefDetail>(&span_detail)) {
+                detail.text = push_string(arena, d->name);
+                detail.flag = d->inserted;
+            }
+            return detail;
+        }
+    };
+
+    bool parse_to_tree(const std::string* text, OFFSET start, OFFSET end, Tree* tree) {
+        tree->clear();
+        /* Rough estimations to avoid most of the reallocations */
+        tree->nodes.reserve((end - start) / 16 + 1);
+        tree->arena.reserve((end - start) / 4 + 1);
+
+        TreeBuilder builder(tree);
+        parse(text, start, end, builder);
+        return true;
+    }
+}
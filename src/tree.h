@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+#include "definitions.h"
+
+namespace AB {
+    /* =========
+     * Flat tree
+     * ========= */
+
+    enum NODE_KIND {
+        NODE_BLOCK,
+        NODE_SPAN,
+        NODE_TEXT
+    };
+
+    /* String stored in the arena of the tree */
+    struct TreeString {
+        SIZE offset = 0;
+        SIZE size = 0;
+    };
+
+    struct TreeAttribute {
+        TreeString key;
+        TreeString value;
+    };
+
+    /**
+     * Detail of a node, the meaning of the fields depends on the type of the node:
+     *  - BLOCK_CODE: text = lang, number = num_ticks
+     *  - BLOCK_OL:   marker = pre_marker, post_marker, number = OL_TYPE, flag = lower_case
+     *  - BLOCK_UL:   marker
+     *  - BLOCK_LI:   text = number, number = level, state = TASK_STATE, flag = is_task
+     *  - BLOCK_DEF:  text = name, number = DEF_TYPE
+     *  - BLOCK_DIV:  text = name
+     *  - BLOCK_H:    number = level
+     *  - SPAN_URL:   text = href, flag = alias
+     *  - SPAN_IMG:   text = src, title, flag = alias
+     *  - SPAN_REF:   text = name, flag = inserted
+     */
+    struct TreeDetail {
+        TreeString text;
+        TreeString title;
+        int number = 0;
+        int state = 0;
+        char marker = 0;
+        char post_marker = 0;
+        bool flag = false;
+    };
+
+    struct TreeNode {
+        NODE_KIND kind;
+        /* BLOCK_TYPE, SPAN_TYPE or TEXT_TYPE, depending on kind */
+        int type;
+        /* Number of nodes in the subtree, including this node. The next
+         * sibling of node i is at i + subtree_size */
+        int subtree_size = 1;
+        /* Index of the parent node, -1 for BLOCK_DOC */
+        int parent = -1;
+
+        /* Offsets in bytes in the arena of the tree */
+        SIZE bounds_offset = 0;
+        SIZE bounds_size = 0;
+        SIZE attributes_offset = 0;
+        SIZE attributes_size = 0;
+        SIZE detail_offset = 0;
+        bool has_detail = false;
+    };
+
+    /**
+     * Result of parse_to_tree(): the nodes of the document, stored contiguously in preorder
+     *
+     * The boundaries, attributes and details of all the nodes live in a single arena
+     * owned by the tree
+     */
+    struct Tree {
+        std::vector<TreeNode> nodes;
+        std::vector<uint64_t> arena;
+
+        const Boundaries* bounds(const TreeNode& node) const {
+            return reinterpret_cast<const Boundaries*>(arena_data() + node.bounds_offset);
+        }
+        const TreeAttribute* attributes(const TreeNode& node) const {
+            return reinterpret_cast<const TreeAttribute*>(arena_data() + node.attributes_offset);
+        }
+        /* Returns nullptr if the node has no detail */
+        const TreeDetail* detail(const TreeNode& node) const {
+            if (!node.has_detail)
+                return nullptr;
+            return reinterpret_cast<const TreeDetail*>(arena_data() + node.detail_offset);
+        }
+        std::string_view str(const TreeString& str) const {
+            return std::string_view(arena_data() + str.offset, str.size);
+        }
+        void clear() {
+            nodes.clear();
+            arena.clear();
+        }
+    private:
+        const char* arena_data() const {
+            return reinterpret_cast<const char*>(arena.data());
+        }
+    };
+
+    /**
+     * Parses the text between start and end and stores the whole document
+     * in tree (which is cleared first)
+    */
+    bool parse_to_tree(const std::string* text, OFFSET start, OFFSET end, Tree* tree);
+}
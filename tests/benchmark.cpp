@@ -29,27 +29,31 @@ std::string pretty_print(float num_bytes) {
     return out.str();
 }
 
-int main() {
-    AB::Parser parser;
-
-    parser.enter_block = [](AB::BLOCK_TYPE, const std::vector<AB::Boundaries>&, const AB::Attributes&, AB::BlockDetailPtr) -> bool {
+/* Does nothing with the events, only measures the parsing */
+struct NullVisitor {
+    bool enter_block(AB::BLOCK_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::BlockDetail&) {
         return true;
-    };
-    parser.leave_block = [](AB::BLOCK_TYPE) -> bool {
+    }
+    bool leave_block(AB::BLOCK_TYPE) {
         return true;
-    };
-    parser.enter_span = [](AB::SPAN_TYPE, const std::vector<AB::Boundaries>&, const AB::Attributes&, AB::SpanDetailPtr) {
+    }
+    bool enter_span(AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::SpanDetail&) {
         return true;
-    };
-    parser.leave_span = [](AB::SPAN_TYPE) {
+    }
+    bool leave_span(AB::SPAN_TYPE) {
         return true;
-    };
-    parser.text = [](AB::TEXT_TYPE, const std::vector<AB::Boundaries>&) {
+    }
+    bool text(AB::TEXT_TYPE, AB::BoundariesView) {
         return true;
-    };
+    }
+};
+
+int main() {
+    NullVisitor visitor;
 
-    std::ifstream ifs("long_doc.ab");
-    std::string txt_input((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+    AB::MappedFile file;
+    file.open("long_doc.ab");
+    std::string txt_input(file.data(), file.size());
 
     for (int i = 1;i < 1000;) {
         std::string input;
@@ -57,7 +61,7 @@ int main() {
             input += txt_input;
         }
         auto t1 = std::chrono::high_resolution_clock::now();
-        AB::parse(&input, 1000, (AB::OFFSET)input.length(), &parser);
+        AB::parse(&input, 1000, (AB::OFFSET)input.length(), visitor);
         auto t2 = std::chrono::high_resolution_clock::now();
         float timing = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() / 1000.f;
 
@@ -2,4 +2,14 @@
 #include <doctest/doctest.h>
 
 #include "t_helpers.h"
-#include "t_testcases.h"
\ No newline at end of file
+#include "t_testcases.h"
+#include "t_incremental.h"
+#include "t_tree.h"
+#include "t_visitor.h"
+#include "t_stream.h"
+#include "t_mapped_file.h"
+#include "t_parallel.h"
+#include "t_spans.h"
+#include "t_attributes.h"
+#include "t_session.h"
+#include "t_blocks.h"
\ No newline at end of file
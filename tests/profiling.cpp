@@ -39,19 +39,19 @@ std::string pretty_print(float num_bytes) {
 int main() {
     AB::Parser parser;
 
-    parser.enter_block = [](AB::BLOCK_TYPE, const std::vector<AB::Boundaries>&, const AB::Attributes&, AB::BlockDetailPtr) -> bool {
+    parser.enter_block = [](AB::BLOCK_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::BlockDetail&) -> bool {
         return true;
     };
     parser.leave_block = [](AB::BLOCK_TYPE) -> bool {
         return true;
     };
-    parser.enter_span = [](AB::SPAN_TYPE, const std::vector<AB::Boundaries>&, const AB::Attributes&, AB::SpanDetailPtr) {
+    parser.enter_span = [](AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::SpanDetail&) {
         return true;
     };
     parser.leave_span = [](AB::SPAN_TYPE) {
         return true;
     };
-    parser.text = [](AB::TEXT_TYPE, const std::vector<AB::Boundaries>&) {
+    parser.text = [](AB::TEXT_TYPE, AB::BoundariesView) {
         return true;
     };
 
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <string>
+#include <vector>
+#include "parser.h"
+
+/* Attributes of the blocks and spans of txt, in the order of the events */
+static std::vector<AB::Attributes> collect_attributes(const std::string& txt) {
+    std::vector<AB::Attributes> all;
+    AB::Parser parser;
+    parser.enter_block = [&](AB::BLOCK_TYPE, AB::BoundariesView, const AB::Attributes& attributes, const AB::BlockDetail&) {
+        if (!attributes.empty())
+            all.push_back(attributes);
+        return true;
+    };
+    parser.leave_block = [](AB::BLOCK_TYPE) { return true; };
+    parser.enter_span = [&](AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes& attributes, const AB::SpanDetail&) {
+        if (!attributes.empty())
+            all.push_back(attributes);
+        return true;
+    };
+    parser.leave_span = [](AB::SPAN_TYPE) { return true; };
+    parser.text = [](AB::TEXT_TYPE, AB::BoundariesView) { return true; };
+    AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &parser);
+    return all;
+}
+
+TEST_SUITE("Attributes") {
+    TEST_CASE("Interned keys") {
+        std::string txt = "::: figure {{ncols=2,center,caption=Two images}}\n    abc\n";
+        auto all = collect_attributes(txt);
+        REQUIRE(all.size() == 1);
+        auto& attributes = all[0];
+        REQUIRE(attributes.size() == 3);
+        CHECK(attributes[0].id == AB::ATTRIBUTE_NCOLS);
+        CHECK(attributes[0].value == "2");
+        CHECK(attributes[1].id == AB::ATTRIBUTE_CENTER);
+        CHECK(attributes[1].value.empty());
+        CHECK(attributes[2].id == AB::ATTRIBUTE_OTHER);
+        CHECK(attributes[2].key == "caption");
+
+        REQUIRE(attributes.find(AB::ATTRIBUTE_NCOLS) != nullptr);
+        CHECK(*attributes.find(AB::ATTRIBUTE_NCOLS) == "2");
+        REQUIRE(attributes.find("caption") != nullptr);
+        CHECK(*attributes.find("caption") == "Two images");
+        CHECK(attributes.find(AB::ATTRIBUTE_L) == nullptr);
+        CHECK(attributes.count("nrows") == 0);
+        CHECK(AB::attribute_key("l") == AB::ATTRIBUTE_L);
+        CHECK(AB::attribute_key("label") == AB::ATTRIBUTE_OTHER);
+    }
+
+    TEST_CASE("Views on the text") {
+        std::string txt = "*a*{{l:my label}}\n";
+        auto all = collect_attributes(txt);
+        REQUIRE(all.size() == 1);
+        REQUIRE(all[0].size() == 1);
+        CHECK(all[0][0].id == AB::ATTRIBUTE_L);
+        CHECK(all[0][0].value == "my label");
+        CHECK(all[0][0].value.data() >= txt.data());
+        CHECK(all[0][0].value.data() < txt.data() + txt.size());
+    }
+
+    TEST_CASE("Skipped chars and copies") {
+        /* The spaces inside a key and the backslashes are skipped */
+        std::string txt = "*a*{{n row s=1\\2, k=v, k=w, a, b, c, d}}\n";
+        auto all = collect_attributes(txt);
+        REQUIRE(all.size() == 1);
+        AB::Attributes attributes = all[0];
+        all.clear();
+        REQUIRE(attributes.size() == 6);
+        CHECK(attributes[0].id == AB::ATTRIBUTE_NROWS);
+        CHECK(attributes[0].key == "nrows");
+        CHECK(attributes[0].value == "12");
+        /* The last value of a key is kept */
+        CHECK(attributes[1].key == "k");
+        CHECK(attributes[1].value == "w");
+        CHECK(attributes[5].key == "d");
+
+        AB::Attributes copy = attributes;
+        attributes.clear();
+        REQUIRE(copy.find("nrows") != nullptr);
+        CHECK(*copy.find("nrows") == "12");
+        CHECK(copy.count("c") == 1);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "parser.h"
+#include "t_spans.h"
+
+TEST_SUITE("Blocks") {
+    TEST_CASE("Small blocks after a large one") {
+        /* The containers of the list are reused by the paragraphs, sending
+         * a paragraph must not cost as much as sending the list */
+        std::string list;
+        std::string paragraphs;
+        for (int i = 0;i < 10000;i++) {
+            list += "- item\n";
+            paragraphs += "Paragraph\n\n";
+        }
+        double list_first = time_per_byte(list + "\n" + paragraphs);
+        double list_last = time_per_byte(paragraphs + list);
+        CHECK_MESSAGE(list_first < 3 * list_last, list_first * 1e9, " ns/B with the list first, ", list_last * 1e9, " ns/B with the list last");
+    }
+    TEST_CASE("Nesting limit") {
+        /* Depth of the deepest block under DOC */
+        auto max_depth = [](const std::string& txt) {
+            int depth = 0;
+            int max = 0;
+            AB::Parser parser;
+            parser.enter_block = [&](AB::BLOCK_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::BlockDetail&) {
+                max = std::max(max, depth++);
+                return true;
+            };
+            parser.leave_block = [&](AB::BLOCK_TYPE) { depth--; return true; };
+            parser.enter_span = [](AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::SpanDetail&) { return true; };
+            parser.leave_span = [](AB::SPAN_TYPE) { return true; };
+            parser.text = [](AB::TEXT_TYPE, AB::BoundariesView) { return true; };
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &parser);
+            return max;
+        };
+        std::string quotes;
+        for (int i = 0;i < 100000;i++)
+            quotes += "> ";
+        quotes += "text\n";
+        quotes += quotes;
+        CHECK(max_depth(quotes) == RECURSE_LIMIT);
+
+        std::string lists;
+        for (int i = 0;i < 2000;i++)
+            lists += std::string(2 * i, ' ') + "- item\n";
+        CHECK(max_depth(lists) <= RECURSE_LIMIT);
+
+        std::string mixed;
+        for (int i = 0;i < 2000;i++)
+            mixed += "> - ";
+        mixed += "text\n";
+        CHECK(max_depth(mixed) <= RECURSE_LIMIT);
+
+        /* Shallow blocks are unchanged */
+        CHECK(max_depth("> > - a\n") == 5);
+    }
+    TEST_CASE("Fenced blocks") {
+        /* Only the markers and the backslashes of the lines of a fenced block are looked at */
+        std::string txt = "```py\nx = `a` + ``b``\n\\```\ny ``` z\n```\nafter\n\n$$\n\\$$ a $ b\n$$\n";
+        std::vector<AB::BLOCK_TYPE> blocks;
+        std::vector<AB::Boundaries> code;
+        AB::Parser parser;
+        parser.enter_block = [&](AB::BLOCK_TYPE b_type, AB::BoundariesView bounds, const AB::Attributes&, const AB::BlockDetail&) {
+            blocks.push_back(b_type);
+            if (b_type == AB::BLOCK_CODE)
+                code.assign(bounds.begin(), bounds.end());
+            return true;
+        };
+        parser.leave_block = [](AB::BLOCK_TYPE) { return true; };
+        parser.enter_span = [](AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::SpanDetail&) { return true; };
+        parser.leave_span = [](AB::SPAN_TYPE) { return true; };
+        parser.text = [](AB::TEXT_TYPE, AB::BoundariesView) { return true; };
+        AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &parser);
+        std::vector<AB::BLOCK_TYPE> expected = { AB::BLOCK_DOC, AB::BLOCK_CODE, AB::BLOCK_P, AB::BLOCK_HIDDEN, AB::BLOCK_LATEX };
+        CHECK(blocks == expected);
+        /* From the opening to the closing line */
+        REQUIRE(code.size() == 5);
+        CHECK(code[0].line_number == 0);
+        CHECK(code[4].line_number == 4);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <string>
+#include <set>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include "parser.h"
+
+/* Records the events sent by the parser, grouped by DOC-level block */
+class EventRecorder {
+public:
+    struct Event {
+        int kind;
+        int type;
+        std::vector<AB::Boundaries> bounds;
+    };
+    typedef std::vector<Event> TopBlock;
+
+    AB::Parser parser;
+    std::vector<TopBlock> blocks;
+
+    EventRecorder() {
+        parser.enter_block = [&](AB::BLOCK_TYPE b_type, AB::BoundariesView bounds, const AB::Attributes&, const AB::BlockDetail&) -> bool {
+            if (level == 1)
+                blocks.emplace_back();
+            if (level > 0)
+                blocks.back().push_back({ 0, b_type, { bounds.begin(), bounds.end() } });
+            level++;
+            return true;
+        };
+        parser.leave_block = [&](AB::BLOCK_TYPE b_type) -> bool {
+            level--;
+            if (level > 0)
+                blocks.back().push_back({ 1, b_type, {} });
+            return true;
+        };
+        parser.enter_span = [&](AB::SPAN_TYPE s_type, AB::BoundariesView bounds, const AB::Attributes&, const AB::SpanDetail&) {
+            blocks.back().push_back({ 2, s_type, { bounds.begin(), bounds.end() } });
+            return true;
+        };
+        parser.leave_span = [&](AB::SPAN_TYPE s_type) {
+            blocks.back().push_back({ 3, s_type, {} });
+            return true;
+        };
+        parser.text = [&](AB::TEXT_TYPE t_type, AB::BoundariesView bounds) {
+            blocks.back().push_back({ 4, t_type, { bounds.begin(), bounds.end() } });
+            return true;
+        };
+    }
+    static AB::OFFSET block_start(const TopBlock& block) {
+        return block.front().bounds.front().pre;
+    }
+    static void shift(TopBlock& block, AB::OFFSET delta, int line_delta) {
+        for (auto& event : block) {
+            for (auto& bound : event.bounds) {
+                bound.line_number += line_delta;
+                bound.pre += delta;
+                bound.beg += delta;
+                bound.end += delta;
+                bound.post += delta;
+            }
+        }
+    }
+    /* If entered_early, the blocks of a may have been entered before being finished,
+     * with the beginning of their boundaries (see ParserSession::max_unsent_blocks) */
+    static bool equal(const std::vector<TopBlock>& a, const std::vector<TopBlock>& b, bool entered_early = false) {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0;i < a.size();i++) {
+            if (a[i].size() != b[i].size())
+                return false;
+            for (size_t j = 0;j < a[i].size();j++) {
+                auto& e1 = a[i][j];
+                auto& e2 = b[i][j];
+                if (e1.kind != e2.kind || e1.type != e2.type)
+                    return false;
+                if (e1.bounds.size() != e2.bounds.size() && !(entered_early && e1.kind == 0 && e1.bounds.size() < e2.bounds.size()))
+                    return false;
+                for (size_t k = 0;k < e1.bounds.size();k++) {
+                    auto& b1 = e1.bounds[k];
+                    auto& b2 = e2.bounds[k];
+                    if (b1.line_number != b2.line_number || b1.pre != b2.pre || b1.beg != b2.beg
+                        || b1.end != b2.end || b1.post != b2.post)
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+private:
+    int level = 0;
+};
+
+static std::vector<std::pair<std::string, std::string>> read_test_files() {
+    namespace fs = std::filesystem;
+    std::set<fs::path> sorted_files;
+    for (auto& entry : fs::directory_iterator(fs::current_path()))
+        if (entry.path().extension() == ".ab")
+            sorted_files.insert(entry.path());
+
+    std::vector<std::pair<std::string, std::string>> files;
+    for (const auto& file : sorted_files) {
+        std::ifstream ifs(file.generic_string());
+        std::string txt_input((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+        files.push_back({ file.filename().generic_string(), txt_input });
+    }
+    return files;
+}
+
+TEST_SUITE("Incremental") {
+    TEST_CASE("Restart points") {
+        for (auto& [name, txt] : read_test_files()) {
+            EventRecorder full;
+            AB::ParseResult result;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &full.parser, &result);
+
+            REQUIRE(result.restart_lines.size() == result.restart_offsets.size());
+            /* Parsing from any restart point must give the same blocks as the full parse */
+            for (size_t i = 0;i < result.restart_offsets.size();i++) {
+                AB::OFFSET point = result.restart_offsets[i];
+                int line = result.restart_lines[i];
+                CHECK(line == (int)std::count(txt.begin(), txt.begin() + point, '\n'));
+
+                EventRecorder partial;
+                AB::parse(&txt, point, (AB::OFFSET)txt.length(), &partial.parser);
+                /* Same thing when the line number of the start is given */
+                EventRecorder partial_with_line;
+                AB::parse(&txt, point, (AB::OFFSET)txt.length(), &partial_with_line.parser, nullptr, line);
+                std::vector<EventRecorder::TopBlock> expected;
+                for (auto& block : full.blocks)
+                    if (EventRecorder::block_start(block) >= point)
+                        expected.push_back(block);
+                CHECK_MESSAGE(EventRecorder::equal(partial.blocks, expected), "Failed for '", name, "' at offset ", point);
+                CHECK_MESSAGE(EventRecorder::equal(partial_with_line.blocks, expected), "Failed with start line for '", name, "' at offset ", point);
+            }
+        }
+    }
+    TEST_CASE("Reparse after edit") {
+        const std::vector<std::pair<int, std::string>> edits = {
+            {0, "x"}, {0, "\n"}, {0, "\n\n"}, {0, "> "}, {0, "- "}, {0, "```\n"}, {1, ""}, {2, "ab"}, {1, "$$"}
+        };
+        for (auto& [name, txt] : read_test_files()) {
+            EventRecorder old_parse;
+            AB::ParseResult result;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &old_parse.parser, &result);
+
+            for (size_t pos = 0;pos < txt.length();pos += 1 + txt.length() / 7) {
+                for (auto& [num_removed, inserted] : edits) {
+                    if (pos + num_removed > txt.length())
+                        continue;
+                    std::string new_txt = txt;
+                    new_txt.replace(pos, num_removed, inserted);
+                    AB::TextEdit edit{ (AB::OFFSET)pos, (AB::OFFSET)(pos + num_removed), (AB::OFFSET)(pos + inserted.length()) };
+                    int line_delta = (int)std::count(inserted.begin(), inserted.end(), '\n')
+                        - (int)std::count(txt.begin() + pos, txt.begin() + pos + num_removed, '\n');
+
+                    EventRecorder full;
+                    AB::parse(&new_txt, 0, (AB::OFFSET)new_txt.length(), &full.parser);
+
+                    EventRecorder partial;
+                    AB::ParseResult new_result;
+                    AB::reparse(&new_txt, result, edit, &partial.parser, &new_result);
+
+                    /* Stitch the unchanged blocks of the previous parse with the re-parsed ones */
+                    AB::OFFSET delta = edit.new_end - edit.old_end;
+                    std::vector<EventRecorder::TopBlock> stitched;
+                    for (auto& block : old_parse.blocks)
+                        if (EventRecorder::block_start(block) < new_result.reparsed_beg)
+                            stitched.push_back(block);
+                    for (auto& block : partial.blocks)
+                        stitched.push_back(block);
+                    for (auto block : old_parse.blocks) {
+                        if (EventRecorder::block_start(block) >= new_result.reparsed_end - delta) {
+                            EventRecorder::shift(block, delta, line_delta);
+                            stitched.push_back(block);
+                        }
+                    }
+                    CHECK_MESSAGE(EventRecorder::equal(stitched, full.blocks), "Failed for '", name, "' at offset ", pos);
+
+                    AB::ParseResult expected_result;
+                    AB::parse(&new_txt, 0, (AB::OFFSET)new_txt.length(), &full.parser, &expected_result);
+                    CHECK_MESSAGE(new_result.restart_offsets == expected_result.restart_offsets, "Wrong restart points for '", name, "' at offset ", pos);
+                    CHECK_MESSAGE(new_result.restart_lines == expected_result.restart_lines, "Wrong restart lines for '", name, "' at offset ", pos);
+                }
+            }
+        }
+    }
+}
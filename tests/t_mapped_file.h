@@ -0,0 +1,28 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <string>
+#include "parser.h"
+#include "t_incremental.h"
+
+TEST_SUITE("Mapped file") {
+    TEST_CASE("Same events as parsing a string") {
+        for (const auto& [name, txt] : read_test_files()) {
+            AB::MappedFile file;
+            REQUIRE(file.open(name));
+            CHECK(std::string(file.data(), file.size()) == txt);
+            CHECK(file.data()[file.size()] == '\0');
+
+            EventRecorder from_string;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &from_string.parser);
+            EventRecorder from_file;
+            CHECK(AB::parse_file(name, &from_file.parser));
+            CHECK_MESSAGE(EventRecorder::equal(from_string.blocks, from_file.blocks), "Different events for test case '", name, "'");
+        }
+    }
+    TEST_CASE("Missing file") {
+        EventRecorder recorder;
+        CHECK(!AB::parse_file("this_file_does_not_exist.ab", &recorder.parser));
+        CHECK(recorder.blocks.empty());
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <string>
+#include "parser.h"
+#include "t_incremental.h"
+#include "t_spans.h"
+
+TEST_SUITE("Parallel") {
+    TEST_CASE("Same events as a serial parse") {
+        /* Big enough to be cut in several chunks */
+        std::string txt;
+        while (txt.length() < 1500000) {
+            for (const auto& [name, content] : read_test_files())
+                txt += content + "\n";
+        }
+        EventRecorder serial;
+        AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &serial.parser);
+        for (int num_threads : { 1, 2, 3, 8, 16 }) {
+            EventRecorder parallel;
+            AB::parse_parallel(&txt, &parallel.parser, num_threads);
+            CHECK_MESSAGE(EventRecorder::equal(parallel.blocks, serial.blocks), "Failed with ", num_threads, " threads");
+        }
+    }
+    TEST_CASE("Spans resolved on a thread pool") {
+        std::string txt;
+        for (const auto& [name, content] : read_test_files())
+            txt += content + "\n";
+        /* DOC-level blocks with many leaves */
+        for (int i = 0;i < 300;i++)
+            txt += "- Item *" + std::to_string(i) + "* with a [link](https://example.com) and `code`\n";
+        txt += "\n";
+        for (int i = 0;i < 300;i++)
+            txt += "> _Quoted_ paragraph {=" + std::to_string(i) + "=} $x^2$\n>\n";
+
+        EventRecorder serial;
+        AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &serial.parser);
+        for (int num_threads : { 1, 2, 4 }) {
+            AB::ThreadPool pool(num_threads);
+            EventRecorder concurrent;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &concurrent.parser, nullptr, -1, &pool);
+            CHECK_MESSAGE(EventRecorder::equal(concurrent.blocks, serial.blocks), "Failed with ", num_threads, " threads");
+        }
+    }
+    TEST_CASE("Details copied by the chunks") {
+        /* The spaces of the languages are skipped, so they are not views on the text */
+        std::string txt;
+        while (txt.length() < 300000)
+            txt += "``` py thon\ncode\n```\n\n[[ref]] and [link](https://example.com)\n\n";
+        struct DetailVisitor: NullVisitor {
+            std::vector<std::string> strings;
+            bool enter_block(AB::BLOCK_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::BlockDetail& detail) {
+                if (auto code = std::get_if<AB::BlockCodeDetail>(&detail))
+                    strings.emplace_back(code->lang);
+                return true;
+            }
+            bool enter_span(AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::SpanDetail& detail) {
+                if (auto a = std::get_if<AB::SpanADetail>(&detail))
+                    strings.emplace_back(a->href);
+                else if (auto ref = std::get_if<AB::SpanRefDetail>(&detail))
+                    strings.emplace_back(ref->name);
+                return true;
+            }
+        };
+        DetailVisitor serial;
+        AB::parse(&txt, 0, (AB::OFFSET)txt.length(), serial);
+        REQUIRE(serial.strings.size() >= 3);
+        CHECK(serial.strings[0] == "python");
+        CHECK(serial.strings[1] == "ref");
+        CHECK(serial.strings[2] == "https://example.com");
+        DetailVisitor parallel;
+        AB::parse_parallel(&txt, parallel, 4);
+        CHECK(parallel.strings == serial.strings);
+    }
+}
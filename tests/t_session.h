@@ -0,0 +1,201 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "parser.h"
+#include "t_incremental.h"
+
+/* Number of calls to operator new since the beginning of the tests */
+static std::atomic<size_t> num_allocations{ 0 };
+
+void* operator new(size_t size) {
+    num_allocations++;
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+/* Counts the events without allocating */
+struct CountingVisitor {
+    size_t num_events = 0;
+    bool enter_block(AB::BLOCK_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::BlockDetail&) { num_events++; return true; }
+    bool leave_block(AB::BLOCK_TYPE) { num_events++; return true; }
+    bool enter_span(AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::SpanDetail&) { num_events++; return true; }
+    bool leave_span(AB::SPAN_TYPE) { num_events++; return true; }
+    bool text(AB::TEXT_TYPE, AB::BoundariesView) { num_events++; return true; }
+};
+
+TEST_SUITE("Session") {
+    TEST_CASE("Same events as without a session") {
+        /* The buffers of each parse are reused by the next one of the session */
+        AB::ParserSession session;
+        for (auto& [name, txt] : read_test_files()) {
+            EventRecorder expected;
+            AB::ParseResult expected_result;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &expected.parser, &expected_result);
+
+            EventRecorder recorder;
+            AB::ParseResult result;
+            session.parse(&txt, 0, (AB::OFFSET)txt.length(), &recorder.parser, &result);
+            CHECK_MESSAGE(EventRecorder::equal(recorder.blocks, expected.blocks), "Failed for '", name, "'");
+            CHECK(result.restart_offsets == expected_result.restart_offsets);
+
+            AB::OFFSET pos = (AB::OFFSET)txt.length() / 2;
+            std::string new_txt = txt;
+            new_txt.insert(pos, "\n- ");
+            AB::TextEdit edit{ pos, pos, pos + 3 };
+            EventRecorder expected_partial, partial;
+            AB::ParseResult expected_new_result, new_result;
+            AB::reparse(&new_txt, result, edit, &expected_partial.parser, &expected_new_result);
+            session.reparse(&new_txt, result, edit, &partial.parser, &new_result);
+            CHECK_MESSAGE(EventRecorder::equal(partial.blocks, expected_partial.blocks), "Failed to reparse '", name, "'");
+            CHECK(new_result.restart_offsets == expected_new_result.restart_offsets);
+        }
+    }
+    TEST_CASE("No allocation in the steady state") {
+        std::string txt;
+        for (int i = 0;i < 50;i++) {
+            txt += "# Title with *emphasis* {{l=title}}\n\n";
+            txt += "A paragraph with a [link](https://example.com/page) and `code`,\n";
+            txt += "on two lines with ~~strike~~ and $x^2$ and a very long line to get past the small strings\n\n";
+            txt += "- item\n  - nested item with **bold**\n- item\n\n";
+            txt += "> Quote\n> > Nested quote\n\n";
+            txt += "```cpp\nint main() {}\n```\n\n";
+            txt += "::: div {{ncols=2,center}}\n    Inside the div\n\n";
+        }
+        AB::ParserSession session;
+        AB::ParseResult result;
+        CountingVisitor visitor;
+        for (auto& [name, file_txt] : read_test_files())
+            session.parse(&file_txt, 0, (AB::OFFSET)file_txt.length(), visitor, &result);
+        session.parse(&txt, 0, (AB::OFFSET)txt.length(), visitor, &result);
+
+        /* Same size, different text */
+        std::string other = txt;
+        for (auto& c : other)
+            if (c == 'e')
+                c = 'a';
+        size_t before = num_allocations;
+        session.parse(&other, 0, (AB::OFFSET)other.length(), visitor, &result);
+        session.parse(&txt, 0, (AB::OFFSET)txt.length(), visitor, &result);
+        CHECK(num_allocations == before);
+        CHECK(visitor.num_events > 0);
+
+        AB::OFFSET pos = (AB::OFFSET)txt.find("Quote");
+        AB::TextEdit edit{ pos, pos + 1, pos + 1 };
+        other = txt;
+        other[pos] = 'q';
+        AB::ParseResult new_result;
+        session.reparse(&other, result, edit, visitor, &new_result);
+        session.reparse(&other, result, edit, visitor, &new_result);
+        before = num_allocations;
+        session.reparse(&other, result, edit, visitor, &new_result);
+        CHECK(num_allocations == before);
+        CHECK(new_result.restart_offsets.size() == result.restart_offsets.size());
+    }
+    TEST_CASE("Closed blocks sent early") {
+        for (auto& [name, txt] : read_test_files()) {
+            EventRecorder expected;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &expected.parser);
+            for (AB::SIZE max_unsent_blocks : { 1, 2, 8 }) {
+                AB::ParserSession session;
+                session.max_unsent_blocks = max_unsent_blocks;
+                EventRecorder recorder;
+                session.parse(&txt, 0, (AB::OFFSET)txt.length(), &recorder.parser);
+                CHECK_MESSAGE(EventRecorder::equal(recorder.blocks, expected.blocks, true), "Failed for '", name, "' with ", max_unsent_blocks, " blocks");
+            }
+        }
+
+        /* The items are sent while the list is parsed, in batches of a bounded size */
+        std::string list;
+        for (int i = 0;i < 20000;i++)
+            list += "- item\n  > quote\n";
+        struct Batches {
+            size_t num_batches = 0;
+            size_t max_events = 0;
+        } batches;
+        auto count_batch = [](const std::vector<AB::Event>& events, void* user_data) {
+            Batches* batches = static_cast<Batches*>(user_data);
+            batches->num_batches++;
+            batches->max_events = std::max(batches->max_events, events.size());
+            return true;
+        };
+        AB::ParserSession session;
+        session.max_unsent_blocks = 64;
+        session.parse_batches(list.data(), 0, (AB::OFFSET)list.length(), count_batch, &batches);
+        CHECK(batches.num_batches > 100);
+        CHECK(batches.max_events < 1000);
+
+        /* Same with the spans of the items resolved concurrently */
+        std::string long_items;
+        for (int i = 0;i < 2000;i++)
+            long_items += "- item with *emphasis* and enough words to be worth a thread of the pool\n";
+        EventRecorder expected, recorder;
+        AB::parse(&long_items, 0, (AB::OFFSET)long_items.length(), &expected.parser);
+        AB::ThreadPool pool(4);
+        session.max_unsent_blocks = 256;
+        session.parse(&long_items, 0, (AB::OFFSET)long_items.length(), &recorder.parser, nullptr, 0, &pool);
+        CHECK(EventRecorder::equal(recorder.blocks, expected.blocks, true));
+        session.max_unsent_blocks = 64;
+
+        /* The containers of the items sent are reused by the next ones */
+        std::string paragraphs;
+        for (int i = 0;i < 20000;i++)
+            paragraphs += "A paragraph\n\n";
+        CountingVisitor visitor;
+        session.parse(&paragraphs, 0, (AB::OFFSET)paragraphs.length(), visitor);
+        session.parse(&paragraphs, 0, (AB::OFFSET)paragraphs.length(), visitor);
+        size_t before = num_allocations;
+        session.parse(&list, 0, (AB::OFFSET)list.length(), visitor);
+        CHECK(num_allocations == before);
+    }
+    TEST_CASE("No allocation for long lines") {
+        /* The lines are classified from offsets on the text, so their
+         * length doesn't matter once the session is warm */
+        auto make_text = [](int num_words, int repetitions) {
+            std::string words;
+            for (int i = 0;i < num_words;i++)
+                words += "word ";
+            std::string txt;
+            for (int i = 0;i < repetitions;i++) {
+                txt += words + "\n\n";
+                txt += "- " + words + "\n\n";
+                txt += "iv) " + words + "\n\n";
+                txt += "[" + words + "]: definition\n\n";
+                txt += "$$ " + words + " $$\n\n";
+            }
+            return txt;
+        };
+        std::string short_lines = make_text(1, 400);
+        std::string long_lines = make_text(200, 4);
+        REQUIRE(long_lines.size() < short_lines.size());
+
+        AB::ParserSession session;
+        CountingVisitor visitor;
+        session.parse(&short_lines, 0, (AB::OFFSET)short_lines.length(), visitor);
+        session.parse(&short_lines, 0, (AB::OFFSET)short_lines.length(), visitor);
+        size_t before = num_allocations;
+        session.parse(&long_lines, 0, (AB::OFFSET)long_lines.length(), visitor);
+        CHECK(num_allocations == before);
+    }
+}
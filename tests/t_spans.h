@@ -0,0 +1,83 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include "parser.h"
+
+struct NullVisitor {
+    bool enter_block(AB::BLOCK_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::BlockDetail&) { return true; }
+    bool leave_block(AB::BLOCK_TYPE) { return true; }
+    bool enter_span(AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::SpanDetail&) { return true; }
+    bool leave_span(AB::SPAN_TYPE) { return true; }
+    bool text(AB::TEXT_TYPE, AB::BoundariesView) { return true; }
+};
+
+/* Best time out of a few parses, in seconds per byte */
+static double time_per_byte(const std::string& txt) {
+    double best = 1e9;
+    for (int i = 0;i < 3;i++) {
+        NullVisitor visitor;
+        auto start = std::chrono::steady_clock::now();
+        AB::parse(&txt, 0, (AB::OFFSET)txt.length(), visitor);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best / txt.length();
+}
+
+TEST_SUITE("Spans") {
+    TEST_CASE("Attributes after a closed span") {
+        /* The first attribute is inside the span, it doesn't belong to any span */
+        std::string txt = "*a {{key=v}} c* and *d*{{k2}}\n";
+        std::vector<AB::Attributes> span_attributes;
+        AB::Parser parser;
+        parser.enter_block = [](AB::BLOCK_TYPE, AB::BoundariesView, const AB::Attributes&, const AB::BlockDetail&) { return true; };
+        parser.leave_block = [](AB::BLOCK_TYPE) { return true; };
+        parser.enter_span = [&](AB::SPAN_TYPE, AB::BoundariesView, const AB::Attributes& attributes, const AB::SpanDetail&) {
+            span_attributes.push_back(attributes);
+            return true;
+        };
+        parser.leave_span = [](AB::SPAN_TYPE) { return true; };
+        parser.text = [](AB::TEXT_TYPE, AB::BoundariesView) { return true; };
+        AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &parser);
+
+        REQUIRE(span_attributes.size() == 2);
+        CHECK(span_attributes[0].empty());
+        CHECK(span_attributes[1].size() == 1);
+        CHECK(span_attributes[1].count("k2") == 1);
+    }
+
+    TEST_CASE("Linear time in the length of a paragraph") {
+        /* Paragraphs made of n repetitions of a pattern which used to be quadratic */
+        std::vector<std::pair<std::string, std::function<std::string(int)>>> cases = {
+            { "Unmatched code spans", [](int n) {
+                std::string txt = "`` ";
+                for (int i = 0;i < n;i++) txt += "` a ` ";
+                return txt; } },
+            { "Spans between openings and closings", [](int n) {
+                std::string txt;
+                for (int i = 0;i < n;i++) txt += "_x ";
+                for (int i = 0;i < n;i++) txt += "*a* ";
+                for (int i = 0;i < n;i++) txt += "y_ ";
+                return txt; } },
+            { "Links without end", [](int n) {
+                std::string txt;
+                for (int i = 0;i < n;i++) txt += "[a](b ";
+                return txt; } },
+            { "Spans on two lines", [](int n) {
+                std::string txt;
+                for (int i = 0;i < n;i++) txt += "x *a\nb* y\n";
+                return txt; } },
+        };
+        for (const auto& [name, make_text] : cases) {
+            double small = time_per_byte(make_text(5000));
+            double large = time_per_byte(make_text(40000));
+            /* A quadratic time would make the ratio close to 8 */
+            CHECK_MESSAGE(large < 3 * small, name, ": ", small * 1e9, " ns/B for 5000 repetitions, ", large * 1e9, " ns/B for 40000");
+        }
+    }
+}
\ No newline at end of file
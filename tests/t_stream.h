@@ -0,0 +1,81 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <string>
+#include <vector>
+#include "parser.h"
+#include "t_incremental.h"
+
+TEST_SUITE("Stream") {
+    TEST_CASE("Same events as parsing the whole text") {
+        for (const auto& [name, txt] : read_test_files()) {
+            EventRecorder full;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &full.parser);
+
+            for (AB::SIZE chunk_size : { 1, 7, 64, 1000 }) {
+                EventRecorder streamed;
+                AB::StreamParser stream(&streamed.parser);
+                stream.min_parse_size = 1;
+                for (AB::SIZE off = 0;off < txt.length();off += chunk_size)
+                    stream.feed(txt.data() + off, std::min(chunk_size, (AB::SIZE)txt.length() - off));
+                stream.finish();
+                CHECK_MESSAGE(EventRecorder::equal(streamed.blocks, full.blocks), "Failed for '", name, "' with chunks of ", chunk_size);
+            }
+        }
+    }
+    TEST_CASE("Closed blocks of an unfinished block") {
+        for (const auto& [name, txt] : read_test_files()) {
+            EventRecorder full;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &full.parser);
+
+            EventRecorder streamed;
+            AB::StreamParser stream(&streamed.parser);
+            stream.min_parse_size = 1;
+            stream.max_unsent_blocks = 2;
+            for (AB::SIZE off = 0;off < txt.length();off += 7)
+                stream.feed(txt.data() + off, std::min((AB::SIZE)7, (AB::SIZE)txt.length() - off));
+            stream.finish();
+            CHECK_MESSAGE(EventRecorder::equal(streamed.blocks, full.blocks, true), "Failed for '", name, "'");
+        }
+
+        /* The first items are received before the end of the list */
+        std::string item = "- item\n";
+        EventRecorder streamed;
+        AB::StreamParser stream(&streamed.parser);
+        stream.min_parse_size = 1;
+        stream.max_unsent_blocks = 16;
+        for (int i = 0;i < 1000;i++)
+            stream.feed(item.data(), (AB::SIZE)item.size());
+        REQUIRE(streamed.blocks.size() == 1);
+        CHECK(streamed.blocks[0].size() > 100);
+        stream.finish();
+        EventRecorder full;
+        std::string list;
+        for (int i = 0;i < 1000;i++)
+            list += item;
+        AB::parse(&list, 0, (AB::OFFSET)list.length(), &full.parser);
+        CHECK(EventRecorder::equal(streamed.blocks, full.blocks, true));
+    }
+    TEST_CASE("Bounded memory") {
+        std::string paragraph = "Some *text* in a paragraph\nwhich continues here\n\n";
+        EventRecorder streamed;
+        AB::StreamParser stream(&streamed.parser);
+        stream.min_parse_size = 1;
+        size_t max_buffer = 0;
+        for (int i = 0;i < 1000;i++) {
+            stream.feed(paragraph.data(), (AB::SIZE)paragraph.size());
+            max_buffer = std::max(max_buffer, stream.buffer().size());
+        }
+        stream.finish();
+        std::vector<AB::Boundaries> paragraphs;
+        for (auto& block : streamed.blocks)
+            if (block.front().type == AB::BLOCK_P)
+                paragraphs.push_back(block.front().bounds.front());
+        CHECK(paragraphs.size() == 1000);
+        CHECK(max_buffer <= 4 * paragraph.size());
+        /* Offsets and line numbers are counted from the beginning of the document */
+        auto& last = paragraphs.back();
+        CHECK(last.line_number == 999 * 3);
+        CHECK(last.beg == (AB::OFFSET)(999 * paragraph.size()));
+    }
+}
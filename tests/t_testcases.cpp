@@ -1,7 +1,7 @@
 #include "t_testcases.h"
 #include <map>
 
-void ParserCheck::print_block_html_enter(AB::BLOCK_TYPE b_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::BlockDetailPtr detail) {
+void ParserCheck::print_block_html_enter(AB::BLOCK_TYPE b_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::BlockDetail& detail) {
     if (b_type != AB::BLOCK_DOC)
         html << std::endl;
     has_entered = true;
@@ -13,17 +13,17 @@ void ParserCheck::print_block_html_enter(AB::BLOCK_TYPE b_type, const std::vecto
     html << "<" << AB::block_to_html(b_type);
 
     if (b_type == AB::BLOCK_DIV) {
-        auto info = std::static_pointer_cast<AB::BlockDivDetail>(detail);
+        auto info = &std::get<AB::BlockDivDetail>(detail);
         html << " class=\"" << info->name << "\"";
     }
     else if (b_type == AB::BLOCK_CODE) {
-        auto info = std::static_pointer_cast<AB::BlockCodeDetail>(detail);
+        auto info = &std::get<AB::BlockCodeDetail>(detail);
         html << " lang=\"" << info->lang << "\"";
     }
 
     std::map<std::string, std::string> ordered_attrs;
-    for (auto& pair : attributes)
-        ordered_attrs[pair.first] = pair.second;
+    for (auto& attribute : attributes)
+        ordered_attrs[std::string(attribute.key)] = attribute.value;
     for (auto& pair : ordered_attrs) {
         html << " " << pair.first;
         if (!pair.second.empty())
@@ -43,7 +43,7 @@ void ParserCheck::print_block_html_enter(AB::BLOCK_TYPE b_type, const std::vecto
             html << txt[i];
     }
 }
-void ParserCheck::print_block_ast(AB::BLOCK_TYPE b_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::BlockDetailPtr detail) {
+void ParserCheck::print_block_ast(AB::BLOCK_TYPE b_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::BlockDetail& detail) {
     for (int i = 0;i < level;i++) {
         ast << "  ";
     }
@@ -70,31 +70,31 @@ void ParserCheck::print_block_html_close(AB::BLOCK_TYPE b_type) {
         html << "</" << AB::block_to_html(b_type) << ">";
 }
 
-void ParserCheck::print_span_html_enter(AB::SPAN_TYPE s_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::SpanDetailPtr detail) {
+void ParserCheck::print_span_html_enter(AB::SPAN_TYPE s_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::SpanDetail& detail) {
     html << "<" << AB::span_to_html(s_type);
 
     if (s_type == AB::SPAN_URL) {
-        auto info = std::static_pointer_cast<AB::SpanADetail>(detail);
+        auto info = &std::get<AB::SpanADetail>(detail);
         html << " href=\"" << info->href << "\"";
         if (info->alias)
             html << " alias";
     }
     else if (s_type == AB::SPAN_IMG) {
-        auto info = std::static_pointer_cast<AB::SpanImgDetail>(detail);
+        auto info = &std::get<AB::SpanImgDetail>(detail);
         html << " src=\"" << info->src << "\" alt=\"" << info->title << "\"";
         if (info->alias)
             html << " alias";
     }
     else if (s_type == AB::SPAN_REF) {
-        auto info = std::static_pointer_cast<AB::SpanRefDetail>(detail);
+        auto info = &std::get<AB::SpanRefDetail>(detail);
         html << " name=\"" << info->name << "\"";
         if (info->inserted)
             html << " inserted";
     }
 
     std::map<std::string, std::string> ordered_attrs;
-    for (auto& pair : attributes)
-        ordered_attrs[pair.first] = pair.second;
+    for (auto& attribute : attributes)
+        ordered_attrs[std::string(attribute.key)] = attribute.value;
     for (auto& pair : ordered_attrs) {
         html << " " << pair.first;
         if (!pair.second.empty())
@@ -108,7 +108,7 @@ void ParserCheck::print_span_html_enter(AB::SPAN_TYPE s_type, const std::vector<
         html << ">";
     }
 }
-void ParserCheck::print_span_ast(AB::SPAN_TYPE s_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::SpanDetailPtr detail) {
+void ParserCheck::print_span_ast(AB::SPAN_TYPE s_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::SpanDetail& detail) {
     for (int i = 0;i < level;i++) {
         ast << "  ";
     }
@@ -128,7 +128,7 @@ void ParserCheck::print_span_html_close(AB::SPAN_TYPE s_type) {
     }
 }
 
-void ParserCheck::print_text_ast(AB::TEXT_TYPE t_type, const std::vector<AB::Boundaries>& bounds) {
+void ParserCheck::print_text_ast(AB::TEXT_TYPE t_type, AB::BoundariesView bounds) {
     for (int i = 0;i < level;i++) {
         ast << "  ";
     }
@@ -144,7 +144,7 @@ void ParserCheck::print_text_ast(AB::TEXT_TYPE t_type, const std::vector<AB::Bou
 }
 
 ParserCheck::ParserCheck() {
-    parser.enter_block = [&](AB::BLOCK_TYPE b_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::BlockDetailPtr detail) -> bool {
+    parser.enter_block = [&](AB::BLOCK_TYPE b_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::BlockDetail& detail) -> bool {
         this->print_block_html_enter(b_type, bounds, attributes, detail);
         this->print_block_ast(b_type, bounds, attributes, detail);
         level++;
@@ -156,7 +156,7 @@ ParserCheck::ParserCheck() {
         has_entered = false;
         return true;
     };
-    parser.enter_span = [&](AB::SPAN_TYPE s_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::SpanDetailPtr detail) {
+    parser.enter_span = [&](AB::SPAN_TYPE s_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::SpanDetail& detail) {
         this->print_span_html_enter(s_type, bounds, attributes, detail);
         this->print_span_ast(s_type, bounds, attributes, detail);
         level++;
@@ -167,7 +167,7 @@ ParserCheck::ParserCheck() {
         this->print_span_html_close(s_type);
         return true;
     };
-    parser.text = [&](AB::TEXT_TYPE t_type, const std::vector<AB::Boundaries>& bounds) {
+    parser.text = [&](AB::TEXT_TYPE t_type, AB::BoundariesView bounds) {
         this->print_text_ast(t_type, bounds);
         int j = 0;
         for (auto bound : bounds) {
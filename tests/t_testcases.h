@@ -28,15 +28,15 @@ private:
 
 public:
     ParserCheck();
-    void print_block_html_enter(AB::BLOCK_TYPE b_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::BlockDetailPtr detail);
+    void print_block_html_enter(AB::BLOCK_TYPE b_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::BlockDetail& detail);
     void print_block_html_close(AB::BLOCK_TYPE b_type);
-    void print_block_ast(AB::BLOCK_TYPE b_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::BlockDetailPtr detail);
+    void print_block_ast(AB::BLOCK_TYPE b_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::BlockDetail& detail);
 
-    void print_span_html_enter(AB::SPAN_TYPE s_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::SpanDetailPtr detail);
+    void print_span_html_enter(AB::SPAN_TYPE s_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::SpanDetail& detail);
     void print_span_html_close(AB::SPAN_TYPE s_type);
-    void print_span_ast(AB::SPAN_TYPE s_type, const std::vector<AB::Boundaries>& bounds, const AB::Attributes& attributes, AB::SpanDetailPtr detail);
+    void print_span_ast(AB::SPAN_TYPE s_type, AB::BoundariesView bounds, const AB::Attributes& attributes, const AB::SpanDetail& detail);
 
-    void print_text_ast(AB::TEXT_TYPE t_type, const std::vector<AB::Boundaries>& bounds);
+    void print_text_ast(AB::TEXT_TYPE t_type, AB::BoundariesView bounds);
 
     int check_ast(const std::string& txt_input, const std::string& expected_ast, const std::string& expected_html, std::string& out_ast, std::string& out_html);
 };
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <string>
+#include <sstream>
+#include <set>
+#include <filesystem>
+#include <fstream>
+#include "parser.h"
+
+/* Prints the tree in the same format as ParserCheck::print_block_ast */
+static std::string tree_to_ast(const AB::Tree& tree) {
+    std::stringstream ast;
+    std::vector<int> subtree_ends;
+    for (int i = 0;i < (int)tree.nodes.size();i++) {
+        while (!subtree_ends.empty() && subtree_ends.back() <= i)
+            subtree_ends.pop_back();
+        auto& node = tree.nodes[i];
+        for (size_t j = 0;j < subtree_ends.size();j++)
+            ast << "  ";
+        if (node.kind == AB::NODE_BLOCK)
+            ast << AB::block_to_name((AB::BLOCK_TYPE)node.type);
+        else if (node.kind == AB::NODE_SPAN)
+            ast << AB::span_to_name((AB::SPAN_TYPE)node.type);
+        else
+            ast << AB::text_to_name((AB::TEXT_TYPE)node.type);
+        const AB::Boundaries* bounds = tree.bounds(node);
+        for (AB::SIZE j = 0;j < node.bounds_size;j++) {
+            auto& bound = bounds[j];
+            ast << " {" << bound.line_number << ": " << bound.pre << ", " << bound.beg
+                << ", " << bound.end << ", " << bound.post << "} ";
+        }
+        ast << std::endl;
+        subtree_ends.push_back(i + node.subtree_size);
+    }
+    return ast.str();
+}
+
+TEST_SUITE("Tree") {
+    TEST_CASE("Flat tree") {
+        namespace fs = std::filesystem;
+        std::set<fs::path> sorted_files;
+        for (auto& entry : fs::directory_iterator(fs::current_path()))
+            if (entry.path().extension() == ".ast")
+                sorted_files.insert(entry.path());
+
+        for (const auto& file : sorted_files) {
+            std::string name = file.stem().generic_string();
+            if (name == "_testbench")
+                continue;
+            std::ifstream ifs1(file.parent_path().append(name + ".ab").generic_string());
+            std::string txt_input((std::istreambuf_iterator<char>(ifs1)), (std::istreambuf_iterator<char>()));
+            std::ifstream ifs2(file.generic_string());
+            std::stringstream expected_ast;
+            expected_ast << ifs2.rdbuf();
+
+            AB::Tree tree;
+            AB::parse_to_tree(&txt_input, 0, (AB::OFFSET)txt_input.length(), &tree);
+            CHECK_MESSAGE(tree_to_ast(tree) == expected_ast.str(), "Failed flat tree for test case '", name, "'");
+
+            /* Check the links between the nodes */
+            for (int i = 1;i < (int)tree.nodes.size();i++) {
+                int parent = tree.nodes[i].parent;
+                CHECK((parent >= 0 && parent < i && i < parent + tree.nodes[parent].subtree_size));
+            }
+        }
+    }
+    TEST_CASE("Flat tree details") {
+        std::string txt = "``` py\nabc\n```\n::: fig {{center,ncols=2}}\n    [abc](example.com) {*b*}{{l:x}}\n";
+        AB::Tree tree;
+        AB::parse_to_tree(&txt, 0, (AB::OFFSET)txt.length(), &tree);
+        int found = 0;
+        for (auto& node : tree.nodes) {
+            auto detail = tree.detail(node);
+            if (node.kind == AB::NODE_BLOCK && node.type == AB::BLOCK_CODE) {
+                REQUIRE(detail != nullptr);
+                CHECK(tree.str(detail->text) == "py");
+                found++;
+            }
+            else if (node.kind == AB::NODE_BLOCK && node.type == AB::BLOCK_DIV) {
+                REQUIRE(detail != nullptr);
+                CHECK(tree.str(detail->text) == "fig");
+                CHECK(node.attributes_size == 2);
+                found++;
+            }
+            else if (node.kind == AB::NODE_SPAN && node.type == AB::SPAN_URL) {
+                REQUIRE(detail != nullptr);
+                CHECK(tree.str(detail->text) == "example.com");
+                found++;
+            }
+            else if (node.kind == AB::NODE_SPAN && node.type == AB::SPAN_STRONG) {
+                CHECK(detail == nullptr);
+                REQUIRE(node.attributes_size == 1);
+                auto attribute = tree.attributes(node)[0];
+                CHECK(tree.str(attribute.key) == "l");
+                CHECK(tree.str(attribute.value) == "x");
+                found++;
+            }
+        }
+        CHECK(found == 4);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <doctest/doctest.h>
+#include <string>
+#include <vector>
+#include "parser.h"
+#include "t_incremental.h"
+
+/* Same recording as EventRecorder, but through the compile-time visitor interface */
+struct RecordingVisitor {
+    std::vector<EventRecorder::TopBlock> blocks;
+    /* Number of events accepted before returning false, -1 to never stop */
+    int stop_after = -1;
+    int num_events = 0;
+
+    bool enter_block(AB::BLOCK_TYPE b_type, AB::BoundariesView bounds, const AB::Attributes&, const AB::BlockDetail&) {
+        if (level == 1)
+            blocks.emplace_back();
+        if (level > 0)
+            blocks.back().push_back({ 0, b_type, { bounds.begin(), bounds.end() } });
+        level++;
+        return accept();
+    }
+    bool leave_block(AB::BLOCK_TYPE b_type) {
+        level--;
+        if (level > 0)
+            blocks.back().push_back({ 1, b_type, {} });
+        return accept();
+    }
+    bool enter_span(AB::SPAN_TYPE s_type, AB::BoundariesView bounds, const AB::Attributes&, const AB::SpanDetail&) {
+        blocks.back().push_back({ 2, s_type, { bounds.begin(), bounds.end() } });
+        return accept();
+    }
+    bool leave_span(AB::SPAN_TYPE s_type) {
+        blocks.back().push_back({ 3, s_type, {} });
+        return accept();
+    }
+    bool text(AB::TEXT_TYPE t_type, AB::BoundariesView bounds) {
+        blocks.back().push_back({ 4, t_type, { bounds.begin(), bounds.end() } });
+        return accept();
+    }
+private:
+    int level = 0;
+
+    bool accept() {
+        num_events++;
+        return stop_after < 0 || num_events < stop_after;
+    }
+};
+
+TEST_SUITE("Visitor") {
+    TEST_CASE("Same events as the callbacks") {
+        for (const auto& [name, txt] : read_test_files()) {
+            EventRecorder callbacks;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), &callbacks.parser);
+            RecordingVisitor visitor;
+            AB::parse(&txt, 0, (AB::OFFSET)txt.length(), visitor);
+            CHECK_MESSAGE(EventRecorder::equal(callbacks.blocks, visitor.blocks), "Different events for test case '", name, "'");
+        }
+    }
+    TEST_CASE("Stop parsing") {
+        std::string txt = "First paragraph\n\n# Title\n\nLast paragraph\n";
+        RecordingVisitor visitor;
+        visitor.stop_after = 3;
+        AB::parse(&txt, 0, (AB::OFFSET)txt.length(), visitor);
+        CHECK(visitor.num_events == 3);
+    }
+}